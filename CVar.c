@@ -21,7 +21,8 @@ CVar *CVarNewCVar() {
     CVar *cvar = calloc(1, sizeof(CVar));
 
     cvar->id = next_synch_resource_id++;
-    cvar->waiting_procs = ListNewList(0);
+    // Look up by ID when a waiting proc is killed
+    cvar->waiting_procs = ListNewList(WAITING_PROCS_HASH_TABLE_SIZE);
 
     return cvar;
 }
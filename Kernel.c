@@ -9,6 +9,9 @@
 
 #include "LoadProgram.h"
 #include "Log.h"
+#include "PageOps.h"
+#include "Scheduler.h"
+#include "Swap.h"
 #include "Traps.h"
 #include "VMem.h"
 #include "SystemCalls.h"
@@ -24,6 +27,9 @@
 // Copies the given kernel stack page table into the region 0 page table. Does not flush the TLB.
 void UseKernelStackForProc(PCB *pcb);
 
+// Returns whether the given key=value boot option has the given key.
+bool BootOptionIs(char *option, char *key);
+
 // Allocate some Kernel Data structures for Tty, process, and synchronization bookkeeping.
 void InitBookkeepingStructs();
 
@@ -36,13 +42,6 @@ KernelContext *SaveCurrentKernelContext(KernelContext *kernel_context, void *cur
 // Saves the current state into current_pcb, then begins running next_pcb
 KernelContext *SaveKernelContextAndSwitch(KernelContext *kernel_context, void *current_pcb, void *next_pcb);
 
-// Copies the data in the region 0 source page number to the frame mapped by the region 0 dest page number.
-void CopyRegion0PageData(unsigned int source_page_number, unsigned int dest_page_number);
-
-
-// Copies the data in the region 1 source page number to the frame mapped by the region 1 dest page number.
-void CopyRegion1PageData(unsigned int source_page_number, unsigned int dest_page_number);
-
 /* Function Implementations */
 
 void SetKernelData(void *_KernelDataStart, void *_KernelDataEnd) {
@@ -53,15 +52,20 @@ void SetKernelData(void *_KernelDataStart, void *_KernelDataEnd) {
 void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt) {
     virtual_memory_enabled = false;
 
+    // The words before the init program's name are boot options.
+    char **init_args = ParseBootOptions(cmd_args);
+
     next_synch_resource_id = 1;
 
     // Initialize the interrupt vector table and write the base address
     // to the REG_VECTOR_BASE register
     TrapTableInit();
 
-    // Create the idle proc
+    // Create the idle proc, which takes the first pid.
+    InitializeProcTable();
     UserContext model_user_context = *uctxt;
     idle_proc = NewBlankPCB(model_user_context);
+    assert(idle_proc->pid == IDLE_PID);
 
     // Perform the malloc for the idle proc's kernel stack page table before making page tables.
     idle_proc->kernel_stack_page_table =
@@ -73,6 +77,11 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt) {
     // Create the idle proc's page table for region 1.
     CreateRegion1PageTable(idle_proc);
 
+    // Initialize the physical memory management data structures. This is the last kernel heap
+    // allocation before virtual memory is enabled, so every frame below the kernel brk after
+    // this call is mapped by the PTEs created below, and every frame above it is free.
+    InitializePhysicalMemoryManagement(pmem_size);
+
     // Create the PTEs for the kernel text and data with the proper protections.
     unsigned int i;
     for (i = 0; i < kernel_brk_page; i++) {
@@ -111,13 +120,11 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt) {
     virtual_memory_enabled = true;
     WriteRegister(REG_VM_ENABLE, 1);
 
-    // Initialize the physical memory management data structures. Then, initialize the
-    // kernel book keeping structs.
-
-    // Make idle the current proc since it has a region 1 page table that this call can use.
+    // Make idle the current proc, since its region 1 page table is the one in use.
     current_proc = idle_proc;
+    idle_proc->state = THEYNIX_PROC_RUNNING;
 
-    InitializePhysicalMemoryManagement(pmem_size);
+    // Initialize the kernel book keeping structs.
     InitBookkeepingStructs();
 
     int rc = LoadProgram("idle", NULL, idle_proc);
@@ -128,14 +135,14 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt) {
 
     // Load the init program.
     char *init_program_name = "init";
-    if (cmd_args[0]) {
-        init_program_name = cmd_args[0];
+    if (init_args[0]) {
+        init_program_name = init_args[0];
     }
     // Load the init program, but first make sure we are pointing to its region 1 page table.
     PCB *init_proc = NewBlankPCBWithPageTables(model_user_context);
-    WriteRegister(REG_PTBR1, (unsigned int) init_proc->region_1_page_table);
-    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
-    rc = LoadProgram(init_program_name, cmd_args, init_proc);
+    assert(init_proc->pid == INIT_PID);
+    UseRegion1ForProc(init_proc);
+    rc = LoadProgram(init_program_name, init_args, init_proc);
     if (rc != SUCCESS) {
         TracePrintf(TRACE_LEVEL_TERMINAL_PROBLEM, "KernelStart: FAILED TO LOAD INIT!!\n");
         Halt();
@@ -143,27 +150,79 @@ void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt) {
 
     // Make idle the current proc.
     current_proc = idle_proc;
-    WriteRegister(REG_PTBR1, (unsigned int) idle_proc->region_1_page_table);
-    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+    UseRegion1ForProc(idle_proc);
 
     // Place the init proc in the ready queue.
     // On the first clock tick, the init process will be initialized and ran.
-    ListAppend(ready_queue, init_proc, init_proc->pid);
+    SchedulerInitProc(init_proc, NULL);
+    SchedulerMakeReady(init_proc);
 
     // Use the idle proc's user context after returning from KernelStart().
     *uctxt = idle_proc->user_context;
 }
 
+char **ParseBootOptions(char *cmd_args[]) {
+    lazy_load_programs = false;
+    base_quantum_ticks = DEFAULT_QUANTUM_TICKS;
+    handoff_on_wake = false;
+    fair_scheduling = false;
+
+    int i;
+    for (i = 0; cmd_args[i] && strchr(cmd_args[i], '='); i++) {
+        char *option = cmd_args[i];
+        char *value = strchr(option, '=') + 1;
+
+        if (BootOptionIs(option, "load") && strcmp(value, "lazy") == 0) {
+            lazy_load_programs = true;
+        } else if (BootOptionIs(option, "load") && strcmp(value, "eager") == 0) {
+            lazy_load_programs = false;
+        } else if (BootOptionIs(option, "handoff") && strcmp(value, "on") == 0) {
+            handoff_on_wake = true;
+        } else if (BootOptionIs(option, "handoff") && strcmp(value, "off") == 0) {
+            handoff_on_wake = false;
+        } else if (BootOptionIs(option, "sched") && strcmp(value, "cfs") == 0) {
+            fair_scheduling = true;
+        } else if (BootOptionIs(option, "sched") && strcmp(value, "mlfq") == 0) {
+            fair_scheduling = false;
+        } else if (BootOptionIs(option, "quantum")) {
+            char *end;
+            long ticks = strtol(value, &end, 10);
+            if (*value && !*end && ticks > 0 && ticks <= MAX_QUANTUM_TICKS) {
+                base_quantum_ticks = ticks;
+            } else {
+                TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
+                        "Ignoring boot option %s: the quantum must be from 1 to %d ticks\n",
+                        option, MAX_QUANTUM_TICKS);
+            }
+        } else {
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Ignoring unknown boot option %s\n", option);
+        }
+    }
+
+    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Boot options: load=%s sched=%s quantum=%u handoff=%s\n",
+            lazy_load_programs ? "lazy" : "eager", fair_scheduling ? "cfs" : "mlfq",
+            base_quantum_ticks, handoff_on_wake ? "on" : "off");
+    return &cmd_args[i];
+}
+
+/*
+  Returns whether the given key=value boot option has the given key.
+*/
+bool BootOptionIs(char *option, char *key) {
+    int key_len = strlen(key);
+    return strncmp(option, key, key_len) == 0 && option[key_len] == '=';
+}
+
 int SetKernelBrk(void *addr) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> SetKernelBrk(%p)\n", addr);
 
     unsigned int new_kernel_brk_page = ADDR_TO_PAGE(addr - 1) + 1;
 
-    // Ensure we aren't imposing on kernel stack limits.
-    if (((unsigned int) addr) > KERNEL_STACK_BASE) {
+    // Ensure we aren't imposing on the temp pages or the kernel stack.
+    if (((unsigned int) addr) > TEMP_PAGES_BASE) {
         TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
-                "Address passed to SetKernelBrk() (%p) is greater than kernel stack base (%p).\n",
-                addr, KERNEL_STACK_BASE);
+                "Address passed to SetKernelBrk() (%p) is greater than temp pages base (%p).\n",
+                addr, TEMP_PAGES_BASE);
         return -1;
     }
 
@@ -213,168 +272,18 @@ void UseKernelStackForProc(PCB *pcb) {
 /*
   Note: This must be executed in the magic kernel context switch space!!!
 
-  First, maps kernel_stack[0] = dest_kernel_stack[-1] and copies
-  kernel_stack[0] <-- kernel_stack[-1] = source_kernel_stack[-1].
-
-  Then, maps kernel_stack[0] = source_kernel_stack[0].
-
-  Then, for i = -2 to 0, maps kernel_stack[i+1] = dest_kernel_stack[i] and copies
-  kernel_stack[i+1] <-- kernel_stack[i] = source_kernel_stack[i].
+  Copies each page of the current kernel stack, which is the source's, into the dest's kernel
+  stack frame, mapped through a temp page. The region 0 kernel stack entries are left alone.
 */
 void CopyKernelStackPageTableAndData(PCB *source, PCB *dest) {
-    unsigned int kernel_stack_base_page = ADDR_TO_PAGE(KERNEL_STACK_BASE);
-    int i;
-
-    // First, map kernel_stack[0] = dest_kernel_stack[-1] and copy
-    // kernel_stack[0] <-- kernel_stack[-1] = source_kernel_stack[-1].
-    region_0_page_table[kernel_stack_base_page] = dest->kernel_stack_page_table[NUM_KERNEL_PAGES - 1];
-    WriteRegister(REG_TLB_FLUSH, kernel_stack_base_page << PAGESHIFT);
-    CopyRegion0PageData(kernel_stack_base_page + NUM_KERNEL_PAGES - 1, kernel_stack_base_page);
-
-    // Then, map kernel_stack[0] = source_kernel_stack[0].
-    region_0_page_table[kernel_stack_base_page] = source->kernel_stack_page_table[0];
-    WriteRegister(REG_TLB_FLUSH, kernel_stack_base_page << PAGESHIFT);
-
-    // Then, for i = -2 to 0, maps kernel_stack[i+1] = dest_kernel_stack[i] and copies
-    // kernel_stack[i+1] <-- kernel_stack[i] = source_kernel_stack[i].
-    for (i = NUM_KERNEL_PAGES - 2; i >= 0; i--) {
-        region_0_page_table[kernel_stack_base_page + i + 1] = dest->kernel_stack_page_table[i];
-        WriteRegister(REG_TLB_FLUSH, (kernel_stack_base_page + i + 1) << PAGESHIFT);
-        CopyRegion0PageData(kernel_stack_base_page + i, kernel_stack_base_page + i + 1);
-    }
-}
-
-/*
-  For each valid page in the source_region_1 table, allocates a frame in the dest_region_1
-  table with PROT_WRITE permission.
-
-  Creates a temporary region 1 page table in the kernel heap and points the TLB to it.
-
-  Maps region_1[0] = dest_region_1[-1] and, if region_1[-1] is valid, copies
-  region_1[0] <-- region_1[-1] = source_region_1[-1].
-
-  Maps region_1[0] = source_kernel_stack[0].
-
-  For i = -2 to 0, maps region_1[i+1] = dest_region_1[i]. If region_1[i] is valid, copies
-  region_1[i+1] <-- region_1[i] = source_region_1[i].
-
-  For each valid page table entry in the source_region_1 table, sets the corresponding
-  dest_region_1 page table entry to have the same protections.
-
-  Sets the TLB to point back to the source region 1 page table and flush.
-*/
-int CopyRegion1PageTableAndData(PCB *source, PCB *dest) { // make sure dest has a region 1 page table calloced
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> CopyRegion1PageTableAndData()\n");
-
-    int i; // Must not be unsigned!
-
-    // For each valid page in the source_region_1 table, allocate a frame in the dest_region_1
-    // table with PROT_WRITE permission.
-    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Mark 1\n");
-    for (i = 0; i < NUM_PAGES_REG_1; i++) {
-        if (source->region_1_page_table[i].valid) {
-            dest->region_1_page_table[i].valid = 1;
-            dest->region_1_page_table[i].prot = PROT_WRITE;
-
-            if (GetUnusedFrame(&(dest->region_1_page_table[i])) == ERROR) {
-                // Not enough physical frames, so released the ones we used and return error.
-                int j;
-                for (j = 0; j < i; j++) {
-                    if (dest->region_1_page_table[j].valid) {
-                        dest->region_1_page_table[j].valid = false;
-                        ReleaseUsedFrame(dest->region_1_page_table[j].pfn);
-                    }
-                }
-
-                TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Not enough unused frames to complete request.\n");
-                return ERROR;
-            }
-        }
-    }
-
-    // Create a temporary region 1 page table in the kernel heap that starts out as a copy of the
-    // source region 1 page table. Point the TLB to it and flush.
-    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Mark 2\n");
-    struct pte *temp_region_1_page_table = (struct pte *) calloc(NUM_PAGES_REG_1, sizeof(struct pte));
-    for (i = 0; i < NUM_PAGES_REG_1; i++) {
-        temp_region_1_page_table[i] = source->region_1_page_table[i];
-    }
-    WriteRegister(REG_PTBR1, (unsigned int) temp_region_1_page_table);
-    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
-
-    // If region_1[-1] is valid, map region_1[0] = dest_region_1[-1] and copy
-    // region_1[0] <-- region_1[-1] = source_region_1[-1].
-    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Mark 3\n");
-    if (temp_region_1_page_table[NUM_PAGES_REG_1 - 1].valid) {
-        temp_region_1_page_table[0] = dest->region_1_page_table[NUM_PAGES_REG_1 - 1];
-        WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE);
-        CopyRegion1PageData(NUM_PAGES_REG_1 - 1, 0);
-    }
-
-    // Map region_1[0] = source_kernel_stack[0].
-    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Mark 4\n");
-    temp_region_1_page_table[0] = source->region_1_page_table[0];
-    WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE);
-
-    // For i = -2 to 0, maps region_1[i+1] = dest_region_1[i]. If region_1[i] is valid, copies
-    // region_1[i+1] <-- region_1[i] = source_region_1[i].
-    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Mark 5\n");
-    for (i = NUM_PAGES_REG_1 - 2; i >= 0; i--) {
-        if (temp_region_1_page_table[i].valid) {
-            temp_region_1_page_table[i + 1] = dest->region_1_page_table[i];
-            WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE + ((i + 1) << PAGESHIFT));
-            CopyRegion1PageData(i, i + 1);
-        }
-    }
-
-    // For each valid page table entry in the source_region_1 table, sets the corresponding
-    // dest_region_1 page table entry to have the same protections.
-    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Mark 6\n");
-    for (i = 0; i < NUM_PAGES_REG_1; i++) {
-        if (source->region_1_page_table[i].valid) {
-            dest->region_1_page_table[i].prot = source->region_1_page_table[i].prot;
-        }
-    }
-
-    // Set the TLB to point back to the source region 1 page table and flush.
-    WriteRegister(REG_PTBR1, (unsigned int) source->region_1_page_table);
-    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
-
-    // Free the temp region 1 page table.
-    free(temp_region_1_page_table);
-
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< CopyRegion1PageTableAndData()\n\n");
-
-    return SUCCESS;
-}
-
-/*
-  Copies the data in the source page number to the frame mapped by the dest page number.
-*/
-void CopyRegion0PageData(unsigned int source_page_number, unsigned int dest_page_number) {
-    char *source_byte_addr;
-    char *dest_byte_addr;
-    unsigned int i;
-    for (i = 0; i < PAGESIZE; i++) {
-        source_byte_addr = (char *)((source_page_number << PAGESHIFT) + i);
-        dest_byte_addr = (char *)((dest_page_number << PAGESHIFT) + i);
-
-        *dest_byte_addr = *source_byte_addr;
-    }
-}
-
-/*
-  Copies the data in the source page number to the frame mapped by the dest page number.
-*/
-void CopyRegion1PageData(unsigned int source_page_number, unsigned int dest_page_number) {
-    char *source_byte_addr;
-    char *dest_byte_addr;
     unsigned int i;
-    for (i = 0; i < PAGESIZE; i++) {
-        source_byte_addr = (char *)((source_page_number << PAGESHIFT) + i + VMEM_1_BASE);
-        dest_byte_addr = (char *)((dest_page_number << PAGESHIFT) + i + VMEM_1_BASE);
+    for (i = 0; i < NUM_KERNEL_PAGES; i++) {
+        assert(region_0_page_table[ADDR_TO_PAGE(KERNEL_STACK_BASE) + i].pfn
+                == source->kernel_stack_page_table[i].pfn);
 
-        *dest_byte_addr = *source_byte_addr;
+        void *dest_frame_addr = MapTempFrame(dest->kernel_stack_page_table[i].pfn);
+        PageCopy(dest_frame_addr, (void *) (KERNEL_STACK_BASE + (i << PAGESHIFT)));
+        UnmapTempFrame(dest_frame_addr);
     }
 }
 
@@ -386,31 +295,30 @@ void InitBookkeepingStructs() {
     // lists because they frequently look up by id
     locks = ListNewList(SYNC_HASH_TABLE_SIZE);
     cvars = ListNewList(SYNC_HASH_TABLE_SIZE);
+    sems = ListNewList(SYNC_HASH_TABLE_SIZE);
     pipes = ListNewList(SYNC_HASH_TABLE_SIZE);
 
-    // Always use ready_queue as a queue, so don't need hash map
-    ready_queue = ListNewList(0);
-
-    // In general, we don't look up by id for procs waiting on the clock
-    clock_block_procs = ListNewList(0);
+    InitializeScheduler();
 
     ttys = (Tty *) calloc(NUM_TERMINALS, sizeof(Tty));
     unsigned int i;
     for (i = 0; i < NUM_TERMINALS; i++) {
         TtyInit(&ttys[i]);
     }
+
+    InitializeSwap();
 }
 
 
-// Context switch to the next process in the ready queue.
+// Context switch to the next process chosen by the scheduler.
 // The next process's context will be loaded into the param user_context.
 // NOTE: place the current proc into the correct queue before calling
 // (e.g., ready queue, clock blocked queue)
 void SwitchToNextProc(UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> SwitchToNextProc()\n");
 
-    // Get the proc at the front of the queue
-    PCB *next_proc = ListDequeue(ready_queue);
+    // Get the proc at the front of the highest priority ready queue
+    PCB *next_proc = SchedulerNextProc();
     if (next_proc) {
         SwitchToProc(next_proc, user_context);
     } else { // No procs waiting, so just switch to the idle proc
@@ -428,18 +336,34 @@ void SwitchToProc(PCB *next_proc, UserContext *user_context) {
     assert(user_context);
     assert(next_proc);
 
+    // Switching to the running proc, e.g. idle when nothing else is ready, is a no-op: its
+    // kernel stack, region 1 page table and TLB entries are all already in place.
+    if (next_proc == current_proc) {
+        current_proc->state = THEYNIX_PROC_RUNNING;
+        TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< SwitchToProc() [already running]\n");
+        return;
+    }
+
     // Save current user state
     current_proc->user_context = *user_context;
 
     TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Loading next proc context into %p\n", user_context);
     TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Loading next proc PID: %d\n", next_proc->pid);
     *user_context = next_proc->user_context;
-    // Set the TLB registers for the region 1 page table.
-    WriteRegister(REG_PTBR1, (unsigned int) next_proc->region_1_page_table);
-    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+    // Set the TLB registers for the region 1 page table, if it isn't loaded already.
+    UseRegion1ForProc(next_proc);
 
     PCB *old_proc = current_proc;
+    old_proc->num_switches_out++;
     current_proc = next_proc;
+
+    // A proc that wasn't made ready, put to sleep or made a zombie before the switch is blocked.
+    // The idle proc is always ready to run.
+    if (old_proc->state == THEYNIX_PROC_RUNNING) {
+        old_proc->state = (old_proc == idle_proc) ? THEYNIX_PROC_READY : THEYNIX_PROC_BLOCKED;
+    }
+    next_proc->state = THEYNIX_PROC_RUNNING;
+    next_proc->wait_list = NULL;
     int rc = KernelContextSwitch(&SaveKernelContextAndSwitch, old_proc, next_proc);
     if (SUCCESS == rc) {
         TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Succesfully switched kernel context!\n");
@@ -484,11 +408,18 @@ KernelContext *SaveKernelContextAndSwitch(KernelContext *kernel_context, void *_
         next_pcb->kernel_context_initialized = true;
     }
 
-    // Use the new proc's kernel stack page table entries in the region 0 page table.
-    UseKernelStackForProc(next_pcb);
-
-    // FLUSH EVERYTHING!!!
-    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_ALL);
+    // Use the new proc's kernel stack page table entries in the region 0 page table, and flush
+    // just the kernel stack pages whose frames changed. The kernel text and heap translations are
+    // the same for every proc, and SwitchToProc() already took care of region 1.
+    unsigned int kernel_stack_base_page = ADDR_TO_PAGE(KERNEL_STACK_BASE);
+    unsigned int i;
+    for (i = 0; i < NUM_KERNEL_PAGES; i++) {
+        if (region_0_page_table[kernel_stack_base_page + i].pfn
+                != next_pcb->kernel_stack_page_table[i].pfn) {
+            region_0_page_table[kernel_stack_base_page + i] = next_pcb->kernel_stack_page_table[i];
+            WriteRegister(REG_TLB_FLUSH, (kernel_stack_base_page + i) << PAGESHIFT);
+        }
+    }
 
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< SaveKernelContextAndSwitch()\n");
     return &(next_pcb->kernel_context);
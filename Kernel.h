@@ -21,26 +21,46 @@
 
 #define KILL -1337
 
+// The proc table hands out pids in order at boot, so idle gets the first and init the second.
 #define INIT_PID 1
 #define IDLE_PID 0
 
 #define SYNC_HASH_TABLE_SIZE 20
 
+// Lists of blocked procs are hashed by pid, so that Kill() can take a proc out of one in O(1).
+#define WAITING_PROCS_HASH_TABLE_SIZE 16
+
 /* Global Variables */
 
 List *locks;
 List *cvars;
+List *sems;
 List *pipes;
 
 Tty *ttys;
 
 PCB *current_proc;
 PCB *idle_proc;
-List *ready_queue;
-List *clock_block_procs;
 
 bool virtual_memory_enabled;
 
+// Boot option load=lazy: LoadProgram() only reserves a program's text and data pages, and each
+// one is read from the executable when first touched. Off (load=eager) by default.
+bool lazy_load_programs;
+
+// Boot option quantum=N: the time slice, in clock ticks, of procs at the top priority level. Each
+// level down gets twice the slice of the level above it. DEFAULT_QUANTUM_TICKS by default.
+unsigned int base_quantum_ticks;
+
+// Boot option handoff=on: a proc that hands a lock to a waiter in Release(), or wakes a waiter in
+// CvarSignal(), switches straight to that proc and donates the rest of its time slice to it,
+// instead of putting it at the back of its ready queue. Off by default.
+bool handoff_on_wake;
+
+// Boot option sched=cfs: use the fair scheduler, which runs the ready proc with the least
+// virtual runtime, instead of the multi-level feedback queue (sched=mlfq). Off by default.
+bool fair_scheduling;
+
 // The lowest page number not in use by the kernel's data segment. Starting at
 // kernel_data_start_page and covering up to, but not including, this page should have
 // PROT_READ | PROT_WRITE permissions.
@@ -63,12 +83,16 @@ void SetKernelData(void *_KernelDataStart, void *_KernelDataEnd);
 
 void KernelStart(char *cmd_args[], unsigned int pmem_size, UserContext *uctxt);
 
+// Sets the kernel options given as key=value words at the start of cmd_args, before the init
+// program's name, and returns the rest of cmd_args.
+char **ParseBootOptions(char *cmd_args[]);
+
 int SetKernelBrk(void *addr);
 
 // Get a copy of the currently running Kernel Context and save it in the current pcb
 void SaveKernelContext();
 
-// Context switch to the next process in the ready queue.
+// Context switch to the next process chosen by the scheduler.
 // The next process's context will be loaded into the param user_context.
 // NOTE: place the current proc into the correct queue before calling
 // (e.g., ready queue, clock blocked queue)
@@ -78,10 +102,4 @@ void SwitchToNextProc(UserContext *user_context);
 // NOTE: place the current proc into the correct queue before calling
 void SwitchToProc(PCB *next_proc, UserContext *user_context);
 
-// Copy the contents of the page table from the source PCB to that of the
-// dest PCB. This includes copying the page table info as well as the
-// actual data in the frames. 
-int CopyRegion1PageTableAndData(PCB *source, PCB *dest);
-
-
 #endif
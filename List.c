@@ -77,6 +77,16 @@ void Increment(void *data) {
     ++*((int *)data);
 }
 
+// Use to test insert in order ftn
+bool IntLessThan(void *new_data, void *data) {
+    return *((int *)new_data) < *((int *)data);
+}
+
+// Use to test remove first match ftn
+bool IntIsEven(void *data) {
+    return *((int *)data) % 2 == 0;
+}
+
 bool ListTestListWithHash() {
     List *list = ListNewList(10);
 
@@ -176,6 +186,29 @@ bool ListTestListNoHash() {
     assert(*first_dequeue == 2);
     assert(*second_dequeue == 3);
 
+    // Test insert in order keeps the list sorted, with ties in FIFO order
+    int sorted[] = { 3, 1, 2, 1 };
+    int i;
+    for (i = 0; i < 4; i++) {
+        ListInsertInOrder(list, &sorted[i], i, &IntLessThan);
+    }
+    assert(ListDequeue(list) == &sorted[1]);
+    assert(ListDequeue(list) == &sorted[3]);
+    assert(ListDequeue(list) == &sorted[2]);
+    assert(ListDequeue(list) == &sorted[0]);
+    assert(ListEmpty(list));
+
+    // Test remove first match takes only the first matching element
+    int odd_even_even[] = { 1, 2, 4 };
+    for (i = 0; i < 3; i++) {
+        ListAppend(list, &odd_even_even[i], i);
+    }
+    assert(ListRemoveFirstMatch(list, &IntIsEven) == &odd_even_even[1]);
+    assert(ListRemoveFirstMatch(list, &IntIsEven) == &odd_even_even[2]);
+    assert(!ListRemoveFirstMatch(list, &IntIsEven));
+    assert(ListDequeue(list) == &odd_even_even[0]);
+    assert(ListEmpty(list));
+
     ListDestroy(list);
 
     return true;
@@ -304,6 +337,23 @@ void *ListFindFirstLessThanIdAndRemove(List *list, unsigned int id) {
     return NULL; // No match
 }
 
+// Remove and return the first element whose data matches, according to the
+// given function. Returns null if none does.
+void *ListRemoveFirstMatch(List *list, bool (*matches) (void *data)) {
+    ListNode *iter = list->head;
+
+    while (iter != list->sentinel) {
+        if (matches(iter->data)) {
+            void *result = iter->data;
+            ListRemoveById(list, iter->id);
+            return result;
+        }
+        iter = iter->next;
+    }
+
+    return NULL; // No match
+}
+
 // Return first element with the given id.
 // returns null if not found
 void *ListFindById(List *list, unsigned int id) {
@@ -377,6 +427,43 @@ void ListAppend(List *list, void *data, unsigned int id) {
     }
 }
 
+// Insert before the first element whose data the new data precedes,
+// according to the given function, or at the end if there is none.
+void ListInsertInOrder(List *list, void *data, unsigned int id,
+        bool (*precedes) (void *new_data, void *data)) {
+    assert(list);
+
+    // Find the first node the new data goes in front of
+    ListNode *iter = list->head;
+    while (iter != list->sentinel && !(*precedes)(data, iter->data)) {
+        iter = iter->next;
+    }
+
+    if (iter == list->head) { // new head, so just push
+        ListPush(list, data, id);
+        return;
+    } else if (iter == list->sentinel) { // goes at the end
+        ListAppend(list, data, id);
+        return;
+    }
+
+    // Link the new node in between iter->prev and iter
+    ListNode *ln = calloc(1, sizeof(ListNode));
+    ln->id = id;
+    ln->data = data;
+
+    ln->prev = iter->prev;
+    ln->next = iter;
+    iter->prev->next = ln;
+    iter->prev = ln;
+    ln->hash_collission_next = NULL;
+
+    // Add to hash if we have it
+    if (list->hash_table_size) {
+        ListAddToHashTable(list, ln);
+    }
+}
+
 // Apply the given function to each item in the list. The function is passed
 // the (void*) data.
 void ListMap(List *list, void (*ftn) (void*)) {
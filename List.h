@@ -77,6 +77,17 @@ void ListAppend(List *list, void *data, unsigned int id);
 // Same as append
 void ListEnqueue(List *list, void *data, unsigned int id);
 
+// Insert before the first element whose data the new data precedes,
+// according to the given function, or at the end if there is none.
+// Elements that the new data doesn't precede stay in front of it, so
+// inserting with a strict ordering keeps ties in FIFO order.
+void ListInsertInOrder(List *list, void *data, unsigned int id,
+        bool (*precedes) (void *new_data, void *data));
+
+// Remove and return the first element whose data matches, according to the
+// given function. Returns null if none does.
+void *ListRemoveFirstMatch(List *list, bool (*matches) (void *data));
+
 // Apply the given function to each item in the list. The function is passed
 // the (void*) data.
 void ListMap(List *list, void (*ftn) (void*));
@@ -11,6 +11,7 @@ THEYNIX
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <assert.h>
 #include <hardware.h>
 #include <load_info.h>
 #include <string.h>
@@ -20,6 +21,8 @@ THEYNIX
 */
 #include "Kernel.h"
 #include "Log.h"
+#include "PageOps.h"
+#include "Swap.h"
 #include "VMem.h"
 
 /*
@@ -196,6 +199,55 @@ LoadProgram(char *name, char *args[], PCB *proc)
   */
   FreeRegion1PageTable(proc);
 
+  /*
+   * Free enough frames for the new address space, waiting for the disk if the pager's buffers
+   * are all in flight. The current proc blocks with the user context it trapped with, and when
+   * it runs again its own region 1 is loaded, so point the TLB back at proc's.
+   */
+  unsigned int num_frames_needed = stack_npg + SWAP_KERNEL_HEAP_RESERVE;
+  if (!lazy_load_programs) {
+    num_frames_needed += li.t_npg + data_npg;
+  }
+  UserContext user_context = current_proc->user_context;
+  if (SwapReserveFrames(num_frames_needed, &user_context) == ERROR) {
+    TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Not enough frames for the program.\n");
+    free(argbuf);
+    close(fd);
+    return ERROR;
+  }
+  UseRegion1ForProc(proc);
+
+  if (lazy_load_programs) {
+    /*
+     * Only reserve the text and data pages. LoadLazyPage() reads each one from
+     * the file, which stays open in the proc's program image, when first touched.
+     */
+    ProgramImage *image = (ProgramImage *) malloc(sizeof(ProgramImage));
+    if (!image) {
+      TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "malloc() for program image failed.\n");
+      free(argbuf);
+      close(fd);
+      return KILL;
+    }
+    image->fd = fd;
+    image->ref_count = 1;
+    image->text_pg1 = text_pg1;
+    image->text_npg = li.t_npg;
+    image->text_faddr = li.t_faddr;
+    image->data_pg1 = data_pg1;
+    image->init_data_npg = li.id_npg;
+    image->init_data_faddr = li.id_faddr;
+    image->init_data_end = li.id_end;
+    image->bss_end = li.ud_end;
+    proc->program_image = image;
+
+    for (i = 0; i < li.t_npg; i++) {
+      proc->region_1_page_info[text_pg1 + i].lazy = true;
+    }
+    for (i = 0; i < data_npg; i++) {
+      proc->region_1_page_info[data_pg1 + i].lazy = true;
+    }
+  } else {
   /*
   ==>> Allocate "li.t_npg" physical pages and map them starting at
   ==>> the "text_pg1" page in region 1 address space.
@@ -217,6 +269,7 @@ if (MapNewRegion1Pages(proc, data_pg1, data_npg, PROT_READ | PROT_WRITE) == ERRO
   TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "MapNewRegion1Pages() for data failed.\n");
   return ERROR;
 }
+  }
 
   /*
    * Allocate memory for the user stack too.
@@ -242,55 +295,57 @@ if (MapNewRegion1Pages(proc, bottom_stack_page, stack_npg,
   // Flush the entire region 1 TLB.
   WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
 
-  /*
-   * Read the text from the file into memory.
-   */
-  lseek(fd, li.t_faddr, SEEK_SET);
-  segment_size = li.t_npg << PAGESHIFT;
-  if (read(fd, (void *) li.t_vaddr, segment_size) != segment_size) {
-    close(fd);
-  /*
-  ==>> KILL is not defined anywhere: it is an error code distinct
-  ==>> from ERROR because it requires different action in the caller.
-  ==>> Since this error code is internal to your kernel, you get to define it.
-  */
-    return KILL;
-  }
-  /*
-   * Read the data from the file into memory.
-   */
-  lseek(fd, li.id_faddr, 0);
-  segment_size = li.id_npg << PAGESHIFT;
+  if (!proc->program_image) {
+    /*
+     * Read the text from the file into memory.
+     */
+    lseek(fd, li.t_faddr, SEEK_SET);
+    segment_size = li.t_npg << PAGESHIFT;
+    if (read(fd, (void *) li.t_vaddr, segment_size) != segment_size) {
+      close(fd);
+    /*
+    ==>> KILL is not defined anywhere: it is an error code distinct
+    ==>> from ERROR because it requires different action in the caller.
+    ==>> Since this error code is internal to your kernel, you get to define it.
+    */
+      return KILL;
+    }
+    /*
+     * Read the data from the file into memory.
+     */
+    lseek(fd, li.id_faddr, 0);
+    segment_size = li.id_npg << PAGESHIFT;
 
-  if (read(fd, (void *) li.id_vaddr, segment_size) != segment_size) {
-    close(fd);
-    return KILL;
-  }
+    if (read(fd, (void *) li.id_vaddr, segment_size) != segment_size) {
+      close(fd);
+      return KILL;
+    }
 
-  /*
-   * Now set the page table entries for the program text to be readable
-   * and executable, but not writable.
-   */
-  /*
-  ==>> Change the protection on the "li.t_npg" pages starting at
-  ==>> virtual address VMEM_1_BASE + (text_pg1 << PAGESHIFT).  Note
-  ==>> that these pages will have indices starting at text_pg1 in
-  ==>> the page table for region 1.
-  ==>> The new protection should be (PROT_READ | PROT_EXEC).
-  ==>> If any of these page table entries is also in the TLB, either
-  ==>> invalidate their entries in the TLB or write the updated entries
-  ==>> into the TLB.  It's nice for the TLB and the page tables to remain
-  ==>> consistent.
-  */
-  ChangeProtRegion1Pages(proc, text_pg1, li.t_npg, PROT_READ | PROT_EXEC);
-  WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+    /*
+     * Now set the page table entries for the program text to be readable
+     * and executable, but not writable.
+     */
+    /*
+    ==>> Change the protection on the "li.t_npg" pages starting at
+    ==>> virtual address VMEM_1_BASE + (text_pg1 << PAGESHIFT).  Note
+    ==>> that these pages will have indices starting at text_pg1 in
+    ==>> the page table for region 1.
+    ==>> The new protection should be (PROT_READ | PROT_EXEC).
+    ==>> If any of these page table entries is also in the TLB, either
+    ==>> invalidate their entries in the TLB or write the updated entries
+    ==>> into the TLB.  It's nice for the TLB and the page tables to remain
+    ==>> consistent.
+    */
+    ChangeProtRegion1Pages(proc, text_pg1, li.t_npg, PROT_READ | PROT_EXEC);
+    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
 
-  close(fd);			/* we've read it all now */
+    close(fd);			/* we've read it all now */
 
-  /*
-   * Zero out the uninitialized data area
-   */
-  bzero((void *) li.id_end, li.ud_end - li.id_end);
+    /*
+     * Zero out the uninitialized data area
+     */
+    ZeroRange((void *) li.id_end, li.ud_end - li.id_end);
+  }
 
   /*
    * Set the entry point in the exception frame.
@@ -306,7 +361,7 @@ if (MapNewRegion1Pages(proc, bottom_stack_page, stack_npg,
    */
 
 #ifdef LINUX
-  memset(cpp, 0x00, VMEM_1_LIMIT - ((int) cpp));
+  ZeroRange(cpp, VMEM_1_LIMIT - ((int) cpp));
 #endif
 
 
@@ -324,6 +379,95 @@ if (MapNewRegion1Pages(proc, bottom_stack_page, stack_npg,
   *cpp++ = NULL;			/* a NULL pointer for an empty envp */
   proc->lowest_user_stack_page = ADDR_TO_PAGE(proc->user_context.sp) - ADDR_TO_PAGE(VMEM_1_BASE);
   proc->user_brk_page = data_pg1 + data_npg;
+  proc->user_heap_start_page = proc->user_brk_page;
+
+  return SUCCESS;
+}
+
+/*
+  Fills the given lazy region 1 page of the proc's program from its ProgramImage, mapping it
+  to a new frame with the protections of its segment. Returns ERROR if there is not enough
+  physical memory or the executable can't be read.
+*/
+int LoadLazyPage(PCB *proc, unsigned int page_num) {
+  TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> LoadLazyPage(%u)\n", page_num);
+
+  ProgramImage *image = proc->program_image;
+  struct pte *pte = &proc->region_1_page_table[page_num];
+  assert(image);
+  assert(proc->region_1_page_info[page_num].lazy);
+  assert(!pte->valid);
+
+  if (GetUnusedFrame(pte) == ERROR) {
+    TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "GetUnusedFrame() failed.\n");
+    return ERROR;
+  }
+
+  // Find where in the file the page comes from, if anywhere. Pages past the initialized
+  // data are all bss.
+  unsigned int prot = PROT_READ | PROT_WRITE;
+  long faddr = -1;
+  if (page_num >= image->text_pg1 && page_num < image->text_pg1 + image->text_npg) {
+    faddr = image->text_faddr + ((page_num - image->text_pg1) << PAGESHIFT);
+    prot = PROT_READ | PROT_EXEC;
+  } else if (page_num >= image->data_pg1
+      && page_num < image->data_pg1 + image->init_data_npg) {
+    faddr = image->init_data_faddr + ((page_num - image->data_pg1) << PAGESHIFT);
+  }
+
+  // Fill the frame through a temp page, before the user can see it.
+  char *frame_addr = (char *) MapTempFrame(pte->pfn);
+  if (faddr >= 0) {
+    lseek(image->fd, faddr, SEEK_SET);
+    if (read(image->fd, frame_addr, PAGESIZE) != PAGESIZE) {
+      TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "read() of page %u failed.\n", page_num);
+      UnmapTempFrame(frame_addr);
+      ReleaseUsedFrame(pte->pfn);
+      return ERROR;
+    }
+  } else {
+    PageZero(frame_addr);
+  }
+
+  // Zero the part of the page that belongs to the bss.
+  unsigned int page_base = VMEM_1_BASE + (page_num << PAGESHIFT);
+  unsigned int zero_start = page_base;
+  if (image->init_data_end > zero_start) {
+    zero_start = image->init_data_end;
+  }
+  unsigned int zero_end = page_base + PAGESIZE;
+  if (image->bss_end < zero_end) {
+    zero_end = image->bss_end;
+  }
+  if (faddr >= 0 && zero_start < zero_end) {
+    ZeroRange(frame_addr + (zero_start - page_base), zero_end - zero_start);
+  }
+  UnmapTempFrame(frame_addr);
+
+  pte->prot = prot;
+  pte->valid = 1;
+  proc->region_1_page_info[page_num].lazy = false;
+  SetFrameOwner(pte->pfn, proc, page_num);
+  AddFramesHeld(proc, 1);
 
+  TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< LoadLazyPage()\n\n");
   return SUCCESS;
 }
+
+/*
+  Drops the proc's reference to its ProgramImage, if it has one, closing the executable when
+  no proc is left using it.
+*/
+void ReleaseProgramImage(PCB *proc) {
+  ProgramImage *image = proc->program_image;
+  if (!image) {
+    return;
+  }
+
+  proc->program_image = NULL;
+  image->ref_count--;
+  if (image->ref_count == 0) {
+    close(image->fd);
+    free(image);
+  }
+}
@@ -2,3 +2,16 @@
 
 int
 LoadProgram(char *name, char *args[], PCB *proc);
+
+/*
+  Fills the given lazy region 1 page of the proc's program from its ProgramImage, mapping it
+  to a new frame with the protections of its segment. Returns ERROR if there is not enough
+  physical memory or the executable can't be read.
+*/
+int LoadLazyPage(PCB *proc, unsigned int page_num);
+
+/*
+  Drops the proc's reference to its ProgramImage, if it has one, closing the executable when
+  no proc is left using it.
+*/
+void ReleaseProgramImage(PCB *proc);
@@ -20,10 +20,8 @@ Lock *LockNewLock() {
     lock->id = next_synch_resource_id++;
     lock->acquired = false;
 
-    // Only look up by ID when a proc dies
-    // while holding the lock, which won't happen
-    // too often
-    lock->waiting_procs = ListNewList(0);
+    // Look up by ID when a waiting proc is killed
+    lock->waiting_procs = ListNewList(WAITING_PROCS_HASH_TABLE_SIZE);
 
     return lock;
 }
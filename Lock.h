@@ -2,6 +2,7 @@
 #define _LOCK_H_
 
 #include "List.h"
+#include "PCB.h"
 
 /*
  * Lock.h
@@ -10,7 +11,7 @@
 
 struct Lock {
     int id;
-    int owner_id;
+    PCB *owner;
 
     List *waiting_procs;
 
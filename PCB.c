@@ -1,33 +1,78 @@
 #include "PCB.h"
 
+#include <assert.h>
 #include <stdlib.h>
 
 #include "Log.h"
 #include "Kernel.h"
 #include "VMem.h"
 
-unsigned int next_pid = 0;
+/*
+  proc_table[pid] is the PCB of the proc with that pid, or NULL if the pid is free.
+
+  The free pids are in a circular queue: the num_free_pids entries of free_pids starting at
+  free_pids_head, oldest first.
+*/
+PCB *proc_table[MAX_PROCS];
+unsigned int free_pids[MAX_PROCS];
+unsigned int free_pids_head;
+unsigned int num_free_pids;
+
+/*
+  Initializes the process table with every pid free, so that pids are first handed out in order
+  from 0.
+*/
+void InitializeProcTable() {
+    unsigned int pid;
+    for (pid = 0; pid < MAX_PROCS; pid++) {
+        proc_table[pid] = NULL;
+        free_pids[pid] = pid;
+    }
+    free_pids_head = 0;
+    num_free_pids = MAX_PROCS;
+}
+
+/*
+  Returns the PCB of the proc, live or zombie, with the given pid, or NULL if there isn't one.
+*/
+PCB *FindProc(int pid) {
+    if (pid < 0 || pid >= MAX_PROCS) {
+        return NULL;
+    }
+    return proc_table[pid];
+}
 
 /*
-  Returns a PCB with the given model UserContext deep cloned and its lists initialized.
+  Returns a PCB with the given model UserContext deep cloned, its lists initialized, and a pid
+  taken from the process table. Returns NULL if every pid is in use.
 */
 PCB *NewBlankPCB(UserContext model_user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> NewBlankPCB()\n");
 
+    if (num_free_pids == 0) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Every pid is in use.\n");
+        return NULL;
+    }
+
     // Malloc for the struct.
     PCB *new_pcb = (PCB *) calloc(1, sizeof(PCB));
 
-    // Give it a PID and increment the global PID counter.
-    new_pcb->pid = next_pid;
-    next_pid++;
+    // Give it the pid that has been free the longest.
+    new_pcb->pid = free_pids[free_pids_head];
+    free_pids_head = (free_pids_head + 1) % MAX_PROCS;
+    num_free_pids--;
+    proc_table[new_pcb->pid] = new_pcb;
+
+    // It runs once it is made ready.
+    new_pcb->state = THEYNIX_PROC_BLOCKED;
 
     // Deep clone the model user context.
     new_pcb->user_context = model_user_context;
 
     // Initialize lists.
     new_pcb->live_children = ListNewList(CHILD_LIST_HASH_SIZE);
-    new_pcb->zombie_children = ListNewList(0);
-    new_pcb->owned_lock_ids = ListNewList(SYNC_HASH_TABLE_SIZE);
+    new_pcb->zombie_children = ListNewList(CHILD_LIST_HASH_SIZE);
+    new_pcb->owned_locks = ListNewList(SYNC_HASH_TABLE_SIZE);
 
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< NewBlankPCB()\n\n");
     return new_pcb;
@@ -41,6 +86,9 @@ PCB *NewBlankPCBWithPageTables(UserContext model_user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> NewBlankPCBWithPageTables()\n");
 
     PCB *pcb = NewBlankPCB(model_user_context);
+    if (!pcb) {
+        return NULL;
+    }
 
     // Create the proc's page table for region 1.
     CreateRegion1PageTable(pcb);
@@ -49,27 +97,79 @@ PCB *NewBlankPCBWithPageTables(UserContext model_user_context) {
     pcb->kernel_stack_page_table =
             (struct pte *) calloc(NUM_KERNEL_PAGES, sizeof(struct pte));
 
-    // Create the PTEs for the proc's kernel stack with newly allocated frames and
+    // Allocate all of the frames for the proc's kernel stack at once.
+    unsigned int pfns[NUM_KERNEL_PAGES];
+    if (GetUnusedFrames(NUM_KERNEL_PAGES, pfns) == ERROR) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "GetUnusedFrames() failed.\n");
+        DestroyRegion1PageTable(pcb);
+        free(pcb->kernel_stack_page_table);
+        ListDestroy(pcb->live_children);
+        ListDestroy(pcb->zombie_children);
+        ListDestroy(pcb->owned_locks);
+        FreePCB(pcb);
+        return NULL;
+    }
+
+    // Create the PTEs for the proc's kernel stack with the newly allocated frames and
     // the proper protections.
     unsigned int i;
     for (i = 0; i < NUM_KERNEL_PAGES; i++) {
-        if (GetUnusedFrame(&(pcb->kernel_stack_page_table[i])) == ERROR) {
-            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "GetUnusedFrame() failed.\n");
-
-            // Release the frames we allocated.
-            int j;
-            for (j = 0; j < i; j++) {
-                pcb->kernel_stack_page_table[j].valid = false;
-                ReleaseUsedFrame(pcb->kernel_stack_page_table[j].pfn);
-            }
-
-            return NULL;
-        }
-
+        pcb->kernel_stack_page_table[i].pfn = pfns[i];
         pcb->kernel_stack_page_table[i].prot = PROT_READ | PROT_WRITE;
         pcb->kernel_stack_page_table[i].valid = 1;
     }
+    AddFramesHeld(pcb, NUM_KERNEL_PAGES);
 
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< NewBlankPCBWithPageTables()\n");
     return pcb;
 }
+
+/*
+  Frees a PCB made by NewBlankPCBWithPageTables() that has never run, along with every frame
+  mapped by its page tables.
+*/
+void FreeUnstartedPCB(PCB *pcb) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> FreeUnstartedPCB()\n");
+
+    FreeRegion1PageTable(pcb);
+    DestroyRegion1PageTable(pcb);
+
+    FreeRegion0StackPages(pcb);
+    free(pcb->kernel_stack_page_table);
+
+    ListDestroy(pcb->live_children);
+    ListDestroy(pcb->zombie_children);
+    ListDestroy(pcb->owned_locks);
+
+    FreePCB(pcb);
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< FreeUnstartedPCB()\n");
+}
+
+/*
+  Frees the given PCB, whose page tables and lists must already be freed, and puts its pid at
+  the back of the free pid queue.
+*/
+void FreePCB(PCB *pcb) {
+    assert(proc_table[pcb->pid] == pcb);
+    assert(num_free_pids < MAX_PROCS);
+
+    proc_table[pcb->pid] = NULL;
+    free_pids[(free_pids_head + num_free_pids) % MAX_PROCS] = pcb->pid;
+    num_free_pids++;
+
+    free(pcb);
+}
+
+/*
+  Adds num_frames, which is negative when frames are unmapped, to the frames the given proc
+  holds, and raises its peak if need be.
+*/
+void AddFramesHeld(PCB *pcb, int num_frames) {
+    assert(num_frames >= 0 || pcb->stats.frames_held >= -num_frames);
+
+    pcb->stats.frames_held += num_frames;
+    if (pcb->stats.frames_held > pcb->stats.peak_frames_held) {
+        pcb->stats.peak_frames_held = pcb->stats.frames_held;
+    }
+}
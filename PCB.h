@@ -6,6 +6,7 @@
 #include "hardware.h"
 #include "List.h"
 #include "PMem.h"
+#include "TheynixCalls.h"
 
 /*
  * PCB.h
@@ -14,11 +15,69 @@
 
 #define NUM_KERNEL_PAGES KERNEL_STACK_MAXSIZE / PAGESIZE
 
+struct Lock;
+
 #define OWNED_LOCK_HASH_SIZE 10
 #define CHILD_LIST_HASH_SIZE 10
 
+// The most procs, including zombies and the idle proc, that can exist at once. Pids are taken
+// from 0 up to, but not including, MAX_PROCS.
+#define MAX_PROCS 256
+
+// Wait() and WaitPid(-1, ...) take any child that has exited.
+#define ANY_CHILD_PID -1
+
 /* Struct */
 
+/*
+  Kernel book keeping for a region 1 page that doesn't fit in the hardware's struct pte.
+*/
+typedef struct PageInfo PageInfo;
+struct PageInfo {
+    // The page's frame may be shared with another process, so PROT_WRITE has been taken away
+    // from the pte. The first write copies the page into a frame of its own.
+    bool copy_on_write;
+
+    // The page is part of a lazily loaded program's text or data, and is invalid until it
+    // is first touched and filled from the proc's ProgramImage.
+    bool lazy;
+
+    // The pager's clock hand took away the page's protections to see whether it is still in use.
+    // The first touch puts saved_prot back.
+    bool clock_revoked;
+
+    // The page's data is in swap slot swap_slot, and its pte is invalid until it's read back.
+    bool swapped;
+    unsigned int swap_slot;
+
+    // The page's real protections while clock_revoked or swapped.
+    unsigned int saved_prot;
+};
+
+/*
+  Where the pages of a lazily loaded program come from in its executable. The file stays open
+  until the last proc using the image, including every proc forked from the one that loaded it,
+  frees its region 1.
+*/
+typedef struct ProgramImage ProgramImage;
+struct ProgramImage {
+    int fd;
+    unsigned int ref_count;
+
+    // Region 1 page numbers and file offsets of the text and initialized data.
+    unsigned int text_pg1;
+    unsigned int text_npg;
+    long text_faddr;
+    unsigned int data_pg1;
+    unsigned int init_data_npg;
+    long init_data_faddr;
+
+    // The bytes from the end of the initialized data up to, but not including,
+    // the end of the bss are zeroed.
+    unsigned int init_data_end;
+    unsigned int bss_end;
+};
+
 /*
   Process Control Block: A struct for keeping track of the various data associated with a given
   user process.
@@ -27,6 +86,9 @@ typedef struct PCB PCB;
 struct PCB {
     unsigned int pid;
 
+    // One of the THEYNIX_PROC_* states in TheynixCalls.h.
+    int state;
+
     // when loading a program
     // for the first time, need to set up kernel
     // context as copy of currently running
@@ -37,6 +99,11 @@ struct PCB {
 
     struct pte *kernel_stack_page_table;
     struct pte *region_1_page_table;
+    // Indexed the same as region_1_page_table.
+    PageInfo *region_1_page_info;
+
+    // Null unless the program in region 1 was loaded lazily.
+    ProgramImage *program_image;
 
     // Null if parent died
     PCB *live_parent;
@@ -46,20 +113,40 @@ struct PCB {
     // children waiting to be collected
     List *zombie_children;
 
-    // Locks this proc has acquired
-    List *owned_lock_ids;
+    // Locks this proc has acquired, with their ids as the list ids
+    List *owned_locks;
+
+    // The lock this proc is waiting for in Acquire(), if any
+    struct Lock *blocked_on_lock;
+
+    // The id of the semaphore whose unit SemUp() handed this proc, until it returns from
+    // SemDown() with it, or 0. If the proc exits first, the unit goes back to the semaphore.
+    int pending_sem_id;
+
+    // While blocked, the list of waiting procs it is in, e.g. a lock's or a terminal's, if any.
+    // Every such list is hashed by pid, so that Kill() can take the proc out in O(1).
+    List *wait_list;
+
+    // Kill() was called while the proc couldn't be stopped, e.g. because the pager or a terminal
+    // is using its memory. It exits the next time it would return to user mode.
+    bool killed;
 
     // Called wait, but no children had died
     bool waiting_on_children;
+    // While waiting_on_children, the pid of the child waited for, or ANY_CHILD_PID.
+    int waiting_on_child_pid;
 
     int lowest_user_stack_page;
     int user_brk_page;
 
+    // The heap covers the region 1 pages from here up to, but not including, user_brk_page.
+    // Brk only reserves heap pages; each one is mapped to a zeroed frame when first touched.
+    int user_heap_start_page;
+
     int exit_status;
 
-    // After Delay, this field tracks
-    // how many clock ticks are left for the process
-    int clock_ticks_until_ready;
+    // After Delay, the clock tick at which the proc is made ready again
+    unsigned int wake_tick;
 
     // The number of bytes this proc is waiting to recieve
     // from the terminal
@@ -78,19 +165,82 @@ struct PCB {
 
     // Number of bytes we are waiting to read from the pipe
     int pipe_read_len;
+
+    // The proc's level in the scheduler's feedback queue, where 0 is the highest priority, and
+    // the number of clock ticks left in its time slice.
+    int priority_level;
+    unsigned int slice_ticks_left;
+
+    // The highest priority level of the procs waiting on locks this proc owns, or the bottom
+    // level if there are none. The proc runs at this level while it is higher than its own.
+    int inherited_priority_level;
+
+    // The scheduling priority set with SetPriority(), from THEYNIX_PRIORITY_MIN to
+    // THEYNIX_PRIORITY_MAX. The proc's time slices are scaled by its weight.
+    int sched_priority;
+
+    // The highest weight of the procs waiting on locks this proc owns, or 0 if there are none.
+    // Under the fair scheduler, the proc runs with this weight while it is higher than its own.
+    unsigned int inherited_weight;
+
+    // Under the fair scheduler, the proc's ticks on the CPU, scaled down by its weight, and its
+    // index in the run heap while it is ready.
+    unsigned int vruntime;
+    unsigned int run_heap_index;
+
+    // Blocked in the pager. The proc's pages are not swapped out until it runs again, so that
+    // the pages the kernel has already validated for it stay resident.
+    bool waiting_on_swap;
+
+    // What the proc has cost so far, for GetProcStats(). stats.voluntary_switches is left at 0;
+    // it is num_switches_out less stats.involuntary_switches.
+    ProcStats stats;
+    unsigned int num_switches_out;
 };
 
 /* Function Prototypes */
 
 /*
-  Returns a PCB with the given UserContext deep cloned and its lists initialized.
+  Initializes the process table, which maps every pid in use to its PCB, with every pid free.
+  Must be called before the first PCB is made.
+
+  Free pids are kept in a queue, so a pid is reused only after every other free pid has been,
+  which makes it less likely that a stale pid names a new proc.
+*/
+void InitializeProcTable();
+
+/*
+  Returns the PCB of the proc, live or zombie, with the given pid, or NULL if there isn't one.
+*/
+PCB *FindProc(int pid);
+
+/*
+  Returns a PCB with the given UserContext deep cloned, its lists initialized, and a pid taken
+  from the process table. Returns NULL if every pid is in use.
 */
 PCB *NewBlankPCB(UserContext model_user_context);
 
 /*
   Same as above but allocates page tables and frames for kernel stack. Returns NULL if there are
-  not enough physical frames to complete this request.
+  not enough physical frames or pids to complete this request.
 */
 PCB *NewBlankPCBWithPageTables(UserContext model_user_context);
 
+/*
+  Frees a PCB made by NewBlankPCBWithPageTables() that has never run, along with every frame
+  mapped by its page tables.
+*/
+void FreeUnstartedPCB(PCB *pcb);
+
+/*
+  Frees the given PCB, whose page tables and lists must already be freed, and frees its pid.
+*/
+void FreePCB(PCB *pcb);
+
+/*
+  Adds num_frames, which is negative when frames are unmapped, to the frames the given proc
+  holds, and raises its peak if need be.
+*/
+void AddFramesHeld(PCB *pcb, int num_frames);
+
 #endif
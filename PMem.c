@@ -1,11 +1,13 @@
 
 #include "PMem.h"
 
+#include <assert.h>
 #include <stdlib.h>
 
 #include "Kernel.h"
 #include "Log.h"
 #include "PCB.h"
+#include "Swap.h"
 
 /*
  * PMem.c
@@ -13,176 +15,203 @@
  */
 
 /*
-  There is a linked list that contains all free frames. Each frame, at offset 0, contains an int
-  that is the number of the next free frame. Each free frame, at offset 1, contains an int pointing
-  to the previous free frame. There is a global variable, free_frames_head, that
-  contains the number of the first free frame in the linked list, and a global variable, 
-  free_frames_tail, that contains the last free frame in the linked list.
+  There is a stack in the kernel heap that contains the numbers of all free frames. The first
+  num_free_frames entries of free_frames are valid, and the top of the stack is at
+  free_frames[num_free_frames - 1]. The stack has room for every frame in physical memory, so a
+  release never needs to grow it.
+
+  frame_ref_counts[i] is the number of page table entries that map frame i, and is 0 for every
+  frame on the free frame stack.
+
+  frame_owners[i] is the region 1 page that last mapped frame i as a private page, if any.
 */
-int free_frames_head; // -1 if list is empty.
-int free_frames_tail; // -1 if list is empty.
+unsigned int *free_frames;
+unsigned int num_free_frames;
+unsigned int num_frames;
+unsigned int *frame_ref_counts;
+
+typedef struct FrameOwner FrameOwner;
+struct FrameOwner {
+  PCB *pcb;
+  unsigned int page_num;
+};
+FrameOwner *frame_owners;
 
 // From Kernel.h
 extern unsigned int kernel_brk_page;
 
 /*    Private Function Prototypes     */
-void AddToLinkedList(int frame_number);
-int GetNextFreeFrameNumber(int frame_number);
-void SetNextAndPrevFreeFrameNumbers(int frame_a, int next_frame_b, int prev_frame_c);
+void PushFreeFrame(unsigned int frame_number);
 
 /*
   Initialize the data structures for keeping track of physical memory.
 */
 void InitializePhysicalMemoryManagement(unsigned int pmem_size) {
-  int max_frame = ((pmem_size + PMEM_BASE) >> PAGESHIFT) - 1;
-
-  // Set head and tail to first frame above kernel heap, which is the kernel brk.
-  free_frames_head = free_frames_tail = kernel_brk_page;
+  num_frames = (pmem_size + PMEM_BASE) >> PAGESHIFT;
+  num_free_frames = 0;
+
+  // Allocate the stack and the reference counts while virtual memory is still disabled, so that
+  // these allocations only move the kernel brk and the frames they cover are left out of the
+  // stack below.
+  free_frames = (unsigned int *) malloc(num_frames * sizeof(unsigned int));
+  frame_ref_counts = (unsigned int *) calloc(num_frames, sizeof(unsigned int));
+  frame_owners = (FrameOwner *) calloc(num_frames, sizeof(FrameOwner));
+  if (!free_frames || !frame_ref_counts || !frame_owners) {
+    TracePrintf(TRACE_LEVEL_TERMINAL_PROBLEM, "Could not allocate the free frame stack!\n");
+    Halt();
+  }
 
-  // Starting with free_frames_head and up to, but not including, the bottom of the kernel stack,
-  // add frames to the free frames list.
-  int i;
-  for (i = free_frames_head + 1; i < ADDR_TO_PAGE(KERNEL_STACK_BASE); i++) {
-    AddToLinkedList(i);
+  // Starting with the first frame above the kernel heap, which is the kernel brk, and up to,
+  // but not including, the bottom of the kernel stack, add frames to the free frame stack.
+  unsigned int i;
+  for (i = kernel_brk_page; i < ADDR_TO_PAGE(KERNEL_STACK_BASE); i++) {
+    PushFreeFrame(i);
   }
 
-  // Starting with the first frame above the kernel stack and up to, including, the max_frame,
-  // add frames to the free frames list.
-  for (i = ADDR_TO_PAGE(KERNEL_STACK_LIMIT) + 1; i <= max_frame; i++) {
-    AddToLinkedList(i);
+  // Starting with the first frame above the kernel stack and up to the last frame,
+  // add frames to the free frame stack.
+  for (i = ADDR_TO_PAGE(KERNEL_STACK_LIMIT); i < num_frames; i++) {
+    PushFreeFrame(i);
   }
+
+  TracePrintf(TRACE_LEVEL_DETAIL_INFO, "%u of %u frames are free.\n", num_free_frames,
+      num_frames);
 }
 
 /*
   If there is an unused frame available, sets the pfn of the given struct pte * to an unused frame
-  and marks it as used. Then returns SUCCESS.
+  and marks it as used. Then returns SUCCESS. If every frame is in use, first tries to swap out a
+  page of another proc to free one.
 
   Otherwise, returns ERROR.
 */
 int GetUnusedFrame(struct pte *pte_ptr) {
-  // Return error if the list is empty.
-  if (free_frames_head < 0) {
+  // Return error if the stack is empty and nothing can be swapped out.
+  if (num_free_frames == 0 && SwapOutPages(1) == ERROR) {
     return ERROR;
   }
 
-  // Get the first frame in the list and store it in pte_ptr->pfn.
-  pte_ptr->pfn = free_frames_head;
+  // Pop the frame on top of the stack and store it in pte_ptr->pfn.
+  num_free_frames--;
+  pte_ptr->pfn = free_frames[num_free_frames];
+  frame_ref_counts[pte_ptr->pfn] = 1;
+
+  return SUCCESS;
+}
+
+/*
+  If there are at least count unused frames available, stores count unused frames in pfns and
+  marks them all as used. Then returns SUCCESS. If there aren't enough, first tries to swap out
+  pages of other procs to free the rest.
 
-  // If free_frames_head was the tail, set both head and tail to -1 to indicate that we are out
-  // of free frames.
-  if (free_frames_head == free_frames_tail) {
-    free_frames_head = free_frames_tail = -1;
-    return SUCCESS;
+  Otherwise, returns ERROR without taking any frames, so the caller has nothing to roll back.
+*/
+int GetUnusedFrames(unsigned int count, unsigned int pfns[]) {
+  // Check the capacity up front so the request is all-or-nothing.
+  if (count > num_free_frames && SwapOutPages(count - num_free_frames) == ERROR) {
+    return ERROR;
   }
 
-  // Otherwise, set free_frames_head to the next frame in the list.
-  int next_frame_number = GetNextFreeFrameNumber(free_frames_head);
-  free_frames_head = next_frame_number;
+  // Pop count frames off the top of the stack.
+  unsigned int i;
+  for (i = 0; i < count; i++) {
+    pfns[i] = free_frames[num_free_frames - 1 - i];
+    frame_ref_counts[pfns[i]] = 1;
+  }
+  num_free_frames -= count;
 
   return SUCCESS;
 }
 
 /*
-  Marks the given used frame as unused.
+  Adds a reference to the given used frame, e.g. because another page table now maps it.
 */
-void ReleaseUsedFrame(int frame_number) {
-  AddToLinkedList(frame_number);
+void RetainUsedFrame(int frame_number) {
+  assert(frame_number >= 0 && frame_number < num_frames);
+  assert(frame_ref_counts[frame_number] > 0);
+
+  frame_ref_counts[frame_number]++;
 }
 
 /*
-  Given the frame number of a free frame A and free frame numbers B and C, sets A to point to B
-  as the next free frame and C as the previous free frame in the linked list.
+  Returns the number of references to the given used frame.
+*/
+unsigned int GetFrameRefCount(int frame_number) {
+  assert(frame_number >= 0 && frame_number < num_frames);
 
-  If A was the tail, the tail is now B. If A was head, the head is now C.
+  return frame_ref_counts[frame_number];
+}
 
-  If either B or C is set to -1, then next or pev is not set, respectively.
+/*
+  Releases a reference to the given used frame. If that was the last reference, marks the frame
+  as unused.
 */
-void SetNextAndPrevFreeFrameNumbers(int frame_a, int next_frame_b, int prev_frame_c) {
-  bool a_was_tail = (frame_a == free_frames_tail);
-  bool a_was_head = (frame_a == free_frames_head);
-
-  // Map frame A into the first page of region 1.
-
-  struct pte *region_1_page_table = (struct pte *) ReadRegister(REG_PTBR1);
-  int actual_pfn = region_1_page_table[0].pfn;
-  int was_valid = region_1_page_table[0].valid;
-  int prev_prots = region_1_page_table[0].prot;
-  region_1_page_table[0].pfn = frame_a;
-  region_1_page_table[0].valid = 1;
-  region_1_page_table[0].prot = PROT_READ | PROT_WRITE;
-  WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE);
-
-  // Write next_frame_b into A[0].
-  int *frame_ptrs = (int *) VMEM_1_BASE;
-  if (next_frame_b >= 0) {
-    frame_ptrs[0] = next_frame_b;
-
-    if (a_was_tail) {
-      free_frames_tail = next_frame_b;
-    }
-  }
+void ReleaseUsedFrame(int frame_number) {
+  assert(frame_number >= 0 && frame_number < num_frames);
+  assert(frame_ref_counts[frame_number] > 0);
 
-  // Write prev_frame_c into A[1].
-  if (prev_frame_c >= 0) {
-    frame_ptrs[1] = prev_frame_c;
+  frame_ref_counts[frame_number]--;
+  if (frame_ref_counts[frame_number] == 0) {
+    PushFreeFrame(frame_number);
+  }
+}
 
-    if (a_was_head) {
-      free_frames_head = prev_frame_c;
-    }
+/*
+  Releases a reference to each of the count used frames in pfns. Each frame whose last reference
+  is released is marked as unused.
+*/
+void ReleaseUsedFrames(unsigned int pfns[], unsigned int count) {
+  unsigned int i;
+  for (i = 0; i < count; i++) {
+    ReleaseUsedFrame(pfns[i]);
   }
+}
+
+/*
+  Records that the given used frame is mapped by the given region 1 page of pcb. Cleared when the
+  frame becomes unused.
+*/
+void SetFrameOwner(int frame_number, PCB *pcb, unsigned int page_num) {
+  assert(frame_number >= 0 && frame_number < num_frames);
+  assert(frame_ref_counts[frame_number] > 0);
 
-  // Remap the first page of region 1.
-  region_1_page_table[0].pfn = actual_pfn;
-  region_1_page_table[0].valid = was_valid;
-  region_1_page_table[0].prot = prev_prots;
-  WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE);
+  frame_owners[frame_number].pcb = pcb;
+  frame_owners[frame_number].page_num = page_num;
 }
 
 /*
-  Appends the given frame to the linked list, making it the new tail.
+  Returns the PCB recorded by SetFrameOwner() for the given frame and stores its page number in
+  page_num_ptr, or returns NULL if none is recorded.
 */
-void AddToLinkedList(int frame_number) {
-  if (free_frames_head < 0) { // Linked list was empty.
-    free_frames_head = free_frames_tail = frame_number;
-  }
+PCB *GetFrameOwner(int frame_number, unsigned int *page_num_ptr) {
+  assert(frame_number >= 0 && frame_number < num_frames);
 
-  int prev_tail = free_frames_tail;
+  *page_num_ptr = frame_owners[frame_number].page_num;
+  return frame_owners[frame_number].pcb;
+}
 
-  SetNextAndPrevFreeFrameNumbers(free_frames_tail, frame_number, -1);
-  SetNextAndPrevFreeFrameNumbers(frame_number, -1, prev_tail);
+/*
+  Returns the number of frames in physical memory.
+*/
+unsigned int GetNumFrames() {
+  return num_frames;
 }
 
 /*
-  Given the frame number of a free frame, returns the free frame number of the next frame
-  in the free frames linked list.
+  Returns the number of frames that are currently unused.
+*/
+unsigned int GetNumFreeFrames() {
+  return num_free_frames;
+}
 
-  Returns -1 if there is no next frame.
+/*
+  Pushes the given frame, which must have no references, onto the free frame stack.
 */
-int GetNextFreeFrameNumber(int frame_number) {
-  if (frame_number == free_frames_tail) {
-    return -1;
-  }
+void PushFreeFrame(unsigned int frame_number) {
+  assert(frame_number < num_frames);
+  assert(num_free_frames < num_frames);
 
-  // Map the frame into the first page of region 1.
-  struct pte *region_1_page_table = (struct pte *) ReadRegister(REG_PTBR1);
-  int actual_pfn = region_1_page_table[0].pfn;
-  int was_valid = region_1_page_table[0].valid;
-  int prev_prots = region_1_page_table[0].prot;
-  region_1_page_table[0].pfn = frame_number;
-  region_1_page_table[0].valid = 1;
-  region_1_page_table[0].prot = PROT_READ | PROT_WRITE;
-  WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE);
-
-  // Obtain the next free frame number at frame[0];
-  int *frame_ptrs = (int *) VMEM_1_BASE;
-  int next_frame_number = frame_ptrs[0];
-
-  // Remap the first page of region 1.
-  region_1_page_table[0].pfn = actual_pfn;
-  region_1_page_table[0].valid = was_valid;
-  region_1_page_table[0].prot = prev_prots;
-  WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE);
-
-  // Return the next free frame number.
-  return next_frame_number;
+  free_frames[num_free_frames] = frame_number;
+  num_free_frames++;
+  frame_owners[frame_number].pcb = NULL;
 }
@@ -3,6 +3,8 @@
 
 #include <hardware.h>
 
+struct PCB;
+
 /*
  * PMem.h
  * Datastructures and helper methods for managing physical memory.
@@ -12,30 +14,81 @@
 /*
   Initializes the data structure for keeping track of physical memory:
 
-  There is a linked list that contains all free frames. Each frame, at offset 0, contains an int
-  that is the number of the next free frame. Each free frame, at offset 1, contains an int pointing
-  to the previous free frame. There is a global variable, free_frames_head, that
-  contains the number of the first free frame in the linked list, and a global variable, 
-  free_frames_tail, that contains the last free frame in the linked list.
+  There is a stack, allocated in the kernel heap, that contains the numbers of all free frames.
+  It is sized from pmem_size, so it can hold every frame in physical memory. Getting and releasing
+  a frame are then a pop and a push, and never need to map the frame or flush the TLB.
+
+  Every frame also has a reference count, so that a frame can be mapped by more than one page
+  table, e.g. when a forked child shares its parent's frames copy-on-write. A frame goes back on
+  the free frame stack only when its last reference is released.
+
+  This must be called before virtual memory is enabled, since the kernel heap can't grow by
+  mapping new frames until the free frame stack exists. Every kernel heap page allocated before
+  this call, including the stack itself, stays out of the free frame stack.
 */
-void InitializePhysicalMemoryManagement();
+void InitializePhysicalMemoryManagement(unsigned int pmem_size);
 
 /*
   If there is an unused frame available, sets the pfn of the given struct pte * to an unused frame
-  and marks it as used. Then returns SUCCESS.
+  and marks it as used with a single reference. Then returns SUCCESS. If every frame is in use,
+  first tries to swap out a page of another proc to free one.
 
   Otherwise, returns ERROR.
 */
 int GetUnusedFrame(struct pte *pte_ptr);
 
 /*
-  Marks the given unused frame as used.
+  If there are at least count unused frames available, stores count unused frames in pfns and
+  marks them all as used with a single reference. Then returns SUCCESS. If there aren't enough,
+  first tries to swap out pages of other procs to free the rest.
+
+  Otherwise, returns ERROR without taking any frames, so the caller has nothing to roll back.
+*/
+int GetUnusedFrames(unsigned int count, unsigned int pfns[]);
+
+/*
+  Adds a reference to the given used frame, e.g. because another page table now maps it.
 */
-void MarkFrameAsUsed(int frame);
+void RetainUsedFrame(int frame);
 
 /*
-  Marks the given used frame as unused.
+  Returns the number of references to the given used frame.
+*/
+unsigned int GetFrameRefCount(int frame);
+
+/*
+  Releases a reference to the given used frame. If that was the last reference, marks the frame
+  as unused.
 */
 void ReleaseUsedFrame(int frame);
 
+/*
+  Releases a reference to each of the count used frames in pfns. Each frame whose last reference
+  is released is marked as unused.
+*/
+void ReleaseUsedFrames(unsigned int pfns[], unsigned int count);
+
+/*
+  Records that the given used frame is mapped by the given region 1 page of pcb, so that the
+  pager can find the page table entry to update when it swaps the frame out. Cleared when the
+  frame becomes unused.
+*/
+void SetFrameOwner(int frame, struct PCB *pcb, unsigned int page_num);
+
+/*
+  Returns the PCB recorded by SetFrameOwner() for the given frame and stores its page number in
+  page_num_ptr, or returns NULL if none is recorded. The owner may no longer map the frame.
+*/
+struct PCB *GetFrameOwner(int frame, unsigned int *page_num_ptr);
+
+/*
+  Returns the number of frames in physical memory.
+*/
+unsigned int GetNumFrames();
+
+/*
+  Returns the number of frames that are currently unused.
+*/
+unsigned int GetNumFreeFrames();
+
 #endif
@@ -0,0 +1,121 @@
+#include "PageOps.h"
+
+#include <assert.h>
+#include <hardware.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * PageOps.c
+ * Routines for copying and zeroing whole pages of memory.
+ */
+
+/*
+  Copies the PAGESIZE bytes at source to dest. Both must be page aligned and mapped.
+*/
+void PageCopy(void *dest, void *source) {
+    assert(((unsigned int) dest & PAGEOFFSET) == 0);
+    assert(((unsigned int) source & PAGEOFFSET) == 0);
+
+#if defined(__SSE2__)
+    __m128i *d = (__m128i *) dest;
+    __m128i *s = (__m128i *) source;
+    __m128i *end = (__m128i *) ((char *) source + PAGESIZE);
+
+    // Four 16-byte loads, then four stores, per iteration.
+    for (; s < end; s += 4, d += 4) {
+        __m128i x0 = _mm_load_si128(s);
+        __m128i x1 = _mm_load_si128(s + 1);
+        __m128i x2 = _mm_load_si128(s + 2);
+        __m128i x3 = _mm_load_si128(s + 3);
+        _mm_store_si128(d, x0);
+        _mm_store_si128(d + 1, x1);
+        _mm_store_si128(d + 2, x2);
+        _mm_store_si128(d + 3, x3);
+    }
+#else
+    unsigned int *d = (unsigned int *) dest;
+    unsigned int *s = (unsigned int *) source;
+    unsigned int *end = (unsigned int *) ((char *) source + PAGESIZE);
+
+    // Eight words per iteration.
+    for (; s < end; s += 8, d += 8) {
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = s[3];
+        d[4] = s[4];
+        d[5] = s[5];
+        d[6] = s[6];
+        d[7] = s[7];
+    }
+#endif
+}
+
+/*
+  Zeroes the PAGESIZE bytes at dest, which must be page aligned and mapped.
+*/
+void PageZero(void *dest) {
+    assert(((unsigned int) dest & PAGEOFFSET) == 0);
+
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i *d = (__m128i *) dest;
+    __m128i *end = (__m128i *) ((char *) dest + PAGESIZE);
+
+    for (; d < end; d += 4) {
+        _mm_store_si128(d, zero);
+        _mm_store_si128(d + 1, zero);
+        _mm_store_si128(d + 2, zero);
+        _mm_store_si128(d + 3, zero);
+    }
+#else
+    unsigned int *d = (unsigned int *) dest;
+    unsigned int *end = (unsigned int *) ((char *) dest + PAGESIZE);
+
+    for (; d < end; d += 8) {
+        d[0] = 0;
+        d[1] = 0;
+        d[2] = 0;
+        d[3] = 0;
+        d[4] = 0;
+        d[5] = 0;
+        d[6] = 0;
+        d[7] = 0;
+    }
+#endif
+}
+
+/*
+  Zeroes the len bytes starting at start, which need not be aligned. Whole pages in the range
+  are zeroed with PageZero().
+*/
+void ZeroRange(void *start, unsigned int len) {
+    char *c = (char *) start;
+    char *end = c + len;
+
+    // Zero bytes up to the first word boundary.
+    while (c < end && ((unsigned int) c & (sizeof(unsigned int) - 1))) {
+        *c++ = 0;
+    }
+
+    // Zero words up to the first page boundary, then whole pages, then the remaining words.
+    unsigned int *w = (unsigned int *) c;
+    while ((char *) (w + 1) <= end && ((unsigned int) w & PAGEOFFSET)) {
+        *w++ = 0;
+    }
+    while ((char *) w + PAGESIZE <= end) {
+        PageZero(w);
+        w = (unsigned int *) ((char *) w + PAGESIZE);
+    }
+    while ((char *) (w + 1) <= end) {
+        *w++ = 0;
+    }
+
+    // Zero the bytes after the last word boundary.
+    for (c = (char *) w; c < end; c++) {
+        *c = 0;
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef _PAGE_OPS_H_
+#define _PAGE_OPS_H_
+
+/*
+ * PageOps.h
+ * Routines for copying and zeroing whole pages of memory.
+ *
+ * The routines are chosen at build time: with SSE2 they move 16 bytes per instruction,
+ * and otherwise they move one 32-bit word at a time.
+ */
+
+/*
+  Copies the PAGESIZE bytes at source to dest. Both must be page aligned and mapped.
+*/
+void PageCopy(void *dest, void *source);
+
+/*
+  Zeroes the PAGESIZE bytes at dest, which must be page aligned and mapped.
+*/
+void PageZero(void *dest);
+
+/*
+  Zeroes the len bytes starting at start, which need not be aligned. Whole pages in the range
+  are zeroed with PageZero().
+*/
+void ZeroRange(void *start, unsigned int len);
+
+#endif
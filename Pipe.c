@@ -22,7 +22,8 @@ Pipe *PipeNewPipe() {
     p->num_chars_available = 0;
     p->buffer_capacity = 0;
 
-    p->waiting_to_read = ListNewList(0);
+    // Look up by ID when a waiting proc is killed
+    p->waiting_to_read = ListNewList(WAITING_PROCS_HASH_TABLE_SIZE);
     return p;
 }
 
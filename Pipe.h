@@ -20,9 +20,9 @@ struct Pipe {
     // points to the first unconsumed byte in the buffer
     void *buffer_ptr;
 
-    // List of procs waiting to read from the buffer.
-    // USE LEN OF BYTES TO READ FOR ID
-     List *waiting_to_read;
+    // List of procs waiting to read from the buffer, by pid. Each one waits for
+    // its pipe_read_len bytes to be available.
+    List *waiting_to_read;
 };
 
 typedef struct Pipe Pipe;
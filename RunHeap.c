@@ -0,0 +1,189 @@
+#include "RunHeap.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "Kernel.h"
+#include "Log.h"
+
+/*
+ * RunHeap.c
+ * A binary min-heap of ready procs keyed by virtual runtime, for the fair scheduler.
+ */
+
+/*    Private Function Prototypes     */
+void RunHeapPlace(RunHeap *heap, PCB *proc, unsigned int index);
+void RunHeapSiftUp(RunHeap *heap, unsigned int index);
+void RunHeapSiftDown(RunHeap *heap, unsigned int index);
+
+// Initialize a new, empty heap
+RunHeap *RunHeapNewRunHeap() {
+    RunHeap *heap = calloc(1, sizeof(RunHeap));
+    heap->capacity = RUN_HEAP_INITIAL_CAPACITY;
+    heap->procs = calloc(heap->capacity, sizeof(PCB *));
+    heap->size = 0;
+    return heap;
+}
+
+// Add the given proc, which must not already be in the heap
+void RunHeapInsert(RunHeap *heap, PCB *proc) {
+    if (heap->size == heap->capacity) {
+        PCB **procs = realloc(heap->procs, 2 * heap->capacity * sizeof(PCB *));
+        if (!procs) {
+            TracePrintf(TRACE_LEVEL_TERMINAL_PROBLEM, "Could not grow the run heap!\n");
+            Halt();
+        }
+        heap->procs = procs;
+        heap->capacity *= 2;
+    }
+
+    RunHeapPlace(heap, proc, heap->size);
+    heap->size++;
+    RunHeapSiftUp(heap, proc->run_heap_index);
+}
+
+// Returns the proc with the least virtual runtime but does not remove it,
+// or returns NULL if the heap is empty
+PCB *RunHeapPeekMin(RunHeap *heap) {
+    if (heap->size == 0) {
+        return NULL;
+    }
+    return heap->procs[0];
+}
+
+// Remove and return the proc with the least virtual runtime,
+// or return NULL if the heap is empty
+PCB *RunHeapPopMin(RunHeap *heap) {
+    PCB *min = RunHeapPeekMin(heap);
+    if (min) {
+        RunHeapRemove(heap, min);
+    }
+    return min;
+}
+
+// Remove the given proc. Returns false if it wasn't in the heap.
+bool RunHeapRemove(RunHeap *heap, PCB *proc) {
+    unsigned int index = proc->run_heap_index;
+    if (index >= heap->size || heap->procs[index] != proc) {
+        return false;
+    }
+
+    // Fill the hole with the last proc, which may belong either above or below it.
+    heap->size--;
+    if (index < heap->size) {
+        RunHeapPlace(heap, heap->procs[heap->size], index);
+        RunHeapSiftUp(heap, index);
+        RunHeapSiftDown(heap, index);
+    }
+    return true;
+}
+
+// Returns whether virtual runtime a is less than b, allowing for wrap around
+bool VruntimeBefore(unsigned int a, unsigned int b) {
+    return (int) (a - b) < 0;
+}
+
+// Put the proc at the given index and record the index in the proc
+void RunHeapPlace(RunHeap *heap, PCB *proc, unsigned int index) {
+    heap->procs[index] = proc;
+    proc->run_heap_index = index;
+}
+
+// Move the proc at the given index up until its parent's runtime isn't greater
+void RunHeapSiftUp(RunHeap *heap, unsigned int index) {
+    PCB *proc = heap->procs[index];
+    while (index > 0) {
+        unsigned int parent = (index - 1) / 2;
+        if (!VruntimeBefore(proc->vruntime, heap->procs[parent]->vruntime)) {
+            break;
+        }
+        RunHeapPlace(heap, heap->procs[parent], index);
+        index = parent;
+    }
+    RunHeapPlace(heap, proc, index);
+}
+
+// Move the proc at the given index down until neither child's runtime is less
+void RunHeapSiftDown(RunHeap *heap, unsigned int index) {
+    PCB *proc = heap->procs[index];
+    while (true) {
+        unsigned int child = 2 * index + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if (child + 1 < heap->size
+                && VruntimeBefore(heap->procs[child + 1]->vruntime, heap->procs[child]->vruntime)) {
+            child++;
+        }
+        if (!VruntimeBefore(heap->procs[child]->vruntime, proc->vruntime)) {
+            break;
+        }
+        RunHeapPlace(heap, heap->procs[child], index);
+        index = child;
+    }
+    RunHeapPlace(heap, proc, index);
+}
+
+/* Testing methods */
+
+bool RunHeapTestRunHeap() {
+    // Comparisons still work across the wrap around
+    assert(VruntimeBefore(1, 2));
+    assert(!VruntimeBefore(2, 1));
+    assert(!VruntimeBefore(5, 5));
+    assert(VruntimeBefore(0xFFFFFFF0, 0x10));
+    assert(!VruntimeBefore(0x10, 0xFFFFFFF0));
+
+    RunHeap *heap = RunHeapNewRunHeap();
+
+    // More procs than the initial capacity, inserted out of order, so the heap has to grow
+    PCB procs[2 * RUN_HEAP_INITIAL_CAPACITY];
+    unsigned int num_procs = 2 * RUN_HEAP_INITIAL_CAPACITY;
+    unsigned int i;
+    for (i = 0; i < num_procs; i++) {
+        procs[i].vruntime = (i * 7) % num_procs;
+        RunHeapInsert(heap, &procs[i]);
+    }
+    assert(heap->size == num_procs);
+
+    // Remove a proc from the middle of the heap, and one that isn't in it
+    PCB *middle = heap->procs[heap->size / 2];
+    assert(RunHeapRemove(heap, middle));
+    assert(!RunHeapRemove(heap, middle));
+
+    // Everything else comes out in order
+    unsigned int last_vruntime = 0;
+    for (i = 0; i < num_procs - 1; i++) {
+        PCB *proc = RunHeapPopMin(heap);
+        assert(proc && proc != middle);
+        assert(!VruntimeBefore(proc->vruntime, last_vruntime));
+        last_vruntime = proc->vruntime;
+    }
+    assert(!RunHeapPeekMin(heap));
+    assert(!RunHeapPopMin(heap));
+
+    // Runtimes just before the wrap around come out before the ones just after it
+    procs[0].vruntime = 0x10;
+    procs[1].vruntime = 0xFFFFFFF0;
+    procs[2].vruntime = 0;
+    for (i = 0; i < 3; i++) {
+        RunHeapInsert(heap, &procs[i]);
+    }
+    assert(RunHeapPopMin(heap) == &procs[1]);
+    assert(RunHeapPopMin(heap) == &procs[2]);
+    assert(RunHeapPopMin(heap) == &procs[0]);
+
+    free(heap->procs);
+    free(heap);
+
+    return true;
+}
+
+/*
+ * uncomment to test
+int main(int argc, char **argv) {
+    assert(RunHeapTestRunHeap());
+
+    return 0;
+}
+*/
@@ -0,0 +1,47 @@
+#ifndef _RUN_HEAP_H_
+#define _RUN_HEAP_H_
+
+#include <stdbool.h>
+
+#include "PCB.h"
+
+/*
+ * RunHeap.h
+ * A binary min-heap of ready procs keyed by virtual runtime, for the fair scheduler.
+ *
+ * The heap is an array that doubles when it fills up. Each proc in the heap knows its index, so
+ * any proc can be removed, not just the one with the least virtual runtime.
+ */
+
+#define RUN_HEAP_INITIAL_CAPACITY 16
+
+struct RunHeap {
+    PCB **procs;
+    unsigned int size;
+    unsigned int capacity;
+};
+
+typedef struct RunHeap RunHeap;
+
+// Initialize a new, empty heap
+RunHeap *RunHeapNewRunHeap();
+
+// Add the given proc, which must not already be in the heap
+void RunHeapInsert(RunHeap *heap, PCB *proc);
+
+// Returns the proc with the least virtual runtime but does not remove it,
+// or returns NULL if the heap is empty
+PCB *RunHeapPeekMin(RunHeap *heap);
+
+// Remove and return the proc with the least virtual runtime,
+// or return NULL if the heap is empty
+PCB *RunHeapPopMin(RunHeap *heap);
+
+// Remove the given proc. Returns false if it wasn't in the heap.
+bool RunHeapRemove(RunHeap *heap, PCB *proc);
+
+// Returns whether virtual runtime a is less than b. Virtual runtimes only grow and the runtimes
+// of ready procs stay close together, so this still works once they wrap around.
+bool VruntimeBefore(unsigned int a, unsigned int b);
+
+#endif
@@ -0,0 +1,533 @@
+#include "Scheduler.h"
+
+#include <assert.h>
+
+#include "Kernel.h"
+#include "List.h"
+#include "Lock.h"
+#include "Log.h"
+#include "RunHeap.h"
+#include "TheynixCalls.h"
+
+/*
+ * Scheduler.c
+ * A multi-level feedback queue, or a fair scheduler, that decides which ready proc runs next.
+ */
+
+// ready_queues[i] holds the ready procs at priority level i, in the order they became ready.
+// Hashed by pid, so that SchedulerRemoveReady() can take a proc out for Kill() without searching.
+List *ready_queues[NUM_PRIORITY_LEVELS];
+
+// The weight of each scheduling priority, from THEYNIX_PRIORITY_MIN up. Each step is about 25%
+// more than the one below, and THEYNIX_PRIORITY_DEFAULT has DEFAULT_PRIORITY_WEIGHT.
+unsigned int priority_weights[THEYNIX_PRIORITY_MAX - THEYNIX_PRIORITY_MIN + 1] = {
+    110, 137, 172, 215, 272, 335, 423, 526, 655, 820,
+    1024,
+    1277, 1586, 1991, 2501, 3121, 3906, 4904, 6100, 7620, 9548
+};
+
+// With fair_scheduling, the ready procs, instead of the ready queues.
+RunHeap *run_heap;
+
+// With fair_scheduling, never more than the virtual runtime of any ready or running proc, and
+// never goes down. Procs that have been blocked or are new are placed relative to it.
+unsigned int min_vruntime;
+
+// The number of procs in all of the ready queues, or the run heap.
+unsigned int num_ready_procs;
+
+// The highest priority level and weight found so far by FindHighestWaiterLevel().
+int highest_waiter_level;
+unsigned int highest_waiter_weight;
+
+// Clock ticks since the ready queues were last aged.
+unsigned int ticks_since_aging;
+
+// The number of clock ticks since boot.
+unsigned int current_tick;
+
+// Procs in Delay(), sorted by wake_tick, with ties in the order they went to sleep. Hashed on pid
+// so that a sleep can be cancelled without searching.
+List *sleeping_procs;
+
+/*    Private Function Prototypes     */
+bool SleepingProcDue();
+void WakeSleepingProcs();
+bool WakesBefore(void *new_proc, void *proc);
+void GiveFreshSlice(PCB *proc);
+bool ProcReadyAtOrAbove(int priority_level);
+void FindHighestWaiterLevel(void *_waiter);
+void FindHighestWaiterLevelOfLock(void *_lock);
+void AgeReadyQueues();
+bool FairTick();
+unsigned int EffectiveWeight(PCB *proc);
+void PlaceNearMinVruntime(PCB *proc);
+void UpdateMinVruntime();
+
+/*
+  Allocates the ready queues, the run heap and the sleeping procs list.
+*/
+void InitializeScheduler() {
+    int i;
+    for (i = 0; i < NUM_PRIORITY_LEVELS; i++) {
+        ready_queues[i] = ListNewList(READY_QUEUE_HASH_TABLE_SIZE);
+    }
+    ticks_since_aging = 0;
+
+    run_heap = RunHeapNewRunHeap();
+    min_vruntime = 0;
+
+    num_ready_procs = 0;
+
+    sleeping_procs = ListNewList(SLEEPING_PROCS_HASH_TABLE_SIZE);
+    current_tick = 0;
+}
+
+/*
+  Starts a new proc at the priority level, scheduling priority and virtual runtime of the given
+  parent, or at the top level, the default priority and min_vruntime if parent is NULL, with a
+  fresh time slice. Children don't start ahead of their parents, so that forking can't be used
+  to climb back to the top level or to the front of the run heap.
+*/
+void SchedulerInitProc(PCB *proc, PCB *parent) {
+    proc->priority_level = parent ? parent->priority_level : TOP_PRIORITY_LEVEL;
+    proc->sched_priority = parent ? parent->sched_priority : THEYNIX_PRIORITY_DEFAULT;
+    proc->inherited_priority_level = BOTTOM_PRIORITY_LEVEL;
+    proc->inherited_weight = 0;
+    proc->vruntime = parent ? parent->vruntime : min_vruntime;
+    GiveFreshSlice(proc);
+}
+
+/*
+  Sets the given proc's scheduling priority, which must be in range. Its next time slice is
+  scaled by the new weight.
+*/
+void SchedulerSetPriority(PCB *proc, int priority) {
+    assert(priority >= THEYNIX_PRIORITY_MIN && priority <= THEYNIX_PRIORITY_MAX);
+    proc->sched_priority = priority;
+}
+
+/*
+  Returns the scheduling weight of the given proc's priority. Procs of the default priority have
+  weight DEFAULT_PRIORITY_WEIGHT.
+*/
+unsigned int SchedulerWeight(PCB *proc) {
+    return priority_weights[proc->sched_priority - THEYNIX_PRIORITY_MIN];
+}
+
+/*
+  Adds the given proc to the back of the ready queue for its effective priority level. With
+  fair_scheduling, adds it to the run heap instead, after PlaceNearMinVruntime().
+*/
+void SchedulerMakeReady(PCB *proc) {
+    assert(proc);
+    assert(proc != idle_proc);
+
+    proc->state = THEYNIX_PROC_READY;
+    proc->wait_list = NULL;
+
+    if (fair_scheduling) {
+        PlaceNearMinVruntime(proc);
+        RunHeapInsert(run_heap, proc);
+        num_ready_procs++;
+        return;
+    }
+
+    int level = SchedulerEffectiveLevel(proc);
+    assert(level >= TOP_PRIORITY_LEVEL && level <= BOTTOM_PRIORITY_LEVEL);
+
+    ListAppend(ready_queues[level], proc, proc->pid);
+    num_ready_procs++;
+}
+
+/*
+  Takes the given proc out of the ready queues. Returns false if it wasn't ready.
+*/
+bool SchedulerRemoveReady(PCB *proc) {
+    if (fair_scheduling) {
+        if (RunHeapRemove(run_heap, proc)) {
+            num_ready_procs--;
+            return true;
+        }
+        return false;
+    }
+
+    int i;
+    for (i = TOP_PRIORITY_LEVEL; i <= BOTTOM_PRIORITY_LEVEL; i++) {
+        if (ListRemoveById(ready_queues[i], proc->pid)) {
+            num_ready_procs--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+  Returns the level the given proc is scheduled at: the higher of its own priority level and the
+  level it inherits from the waiters on its locks.
+*/
+int SchedulerEffectiveLevel(PCB *proc) {
+    if (proc->inherited_priority_level < proc->priority_level) {
+        return proc->inherited_priority_level;
+    }
+    return proc->priority_level;
+}
+
+/*
+  Recomputes the priority level the given proc inherits from the procs waiting on the locks it
+  owns. If the proc's effective level changes, moves it to its new ready queue if it is ready,
+  and passes the change on to the owner of the lock it is waiting for, if any.
+*/
+void SchedulerUpdateInheritedPriority(PCB *proc) {
+    highest_waiter_level = BOTTOM_PRIORITY_LEVEL;
+    highest_waiter_weight = 0;
+    ListMap(proc->owned_locks, &FindHighestWaiterLevelOfLock);
+
+    int old_level = SchedulerEffectiveLevel(proc);
+    unsigned int old_weight = EffectiveWeight(proc);
+    proc->inherited_priority_level = highest_waiter_level;
+    proc->inherited_weight = highest_waiter_weight;
+    if (SchedulerEffectiveLevel(proc) == old_level && EffectiveWeight(proc) == old_weight) {
+        return;
+    }
+
+    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Proc %d now runs at level %d with weight %u\n",
+        proc->pid, SchedulerEffectiveLevel(proc), EffectiveWeight(proc));
+
+    // The run heap is keyed by virtual runtime, which a new weight doesn't change.
+    if (!fair_scheduling && SchedulerEffectiveLevel(proc) != old_level
+            && SchedulerRemoveReady(proc)) {
+        SchedulerMakeReady(proc);
+    }
+
+    // Every change moves levels the same way along a chain of locks, so this ends even if the
+    // chain is a deadlocked cycle.
+    if (proc->blocked_on_lock) {
+        SchedulerUpdateInheritedPriority(proc->blocked_on_lock->owner);
+    }
+}
+
+/*
+  Removes and returns the proc at the front of the highest non-empty ready queue, or returns NULL
+  if no proc is ready.
+*/
+PCB *SchedulerNextProc() {
+    if (fair_scheduling) {
+        PCB *proc = RunHeapPopMin(run_heap);
+        if (proc) {
+            num_ready_procs--;
+        }
+        return proc;
+    }
+
+    int i;
+    for (i = TOP_PRIORITY_LEVEL; i <= BOTTOM_PRIORITY_LEVEL; i++) {
+        PCB *proc = (PCB *) ListDequeue(ready_queues[i]);
+        if (proc) {
+            num_ready_procs--;
+            return proc;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+  Promotes the given proc a priority level, because it is about to block waiting on I/O or a
+  lock, and gives it a fresh time slice.
+*/
+void SchedulerBoost(PCB *proc) {
+    // The fair scheduler favors procs that block by placing them near the least virtual runtime
+    // when they wake up.
+    if (fair_scheduling) {
+        return;
+    }
+
+    if (proc->priority_level > TOP_PRIORITY_LEVEL) {
+        proc->priority_level--;
+    }
+    GiveFreshSlice(proc);
+}
+
+/*
+  Gives the rest of the donor's time slice, and its priority level if that is higher, to the
+  recipient, which the donor is about to switch straight to. The donor gets a fresh slice for
+  its next turn.
+*/
+void SchedulerDonateSlice(PCB *donor, PCB *recipient) {
+    assert(donor != idle_proc && recipient != idle_proc);
+
+    // Under the fair scheduler, the recipient takes the donor's place in line instead. It skips
+    // SchedulerMakeReady(), so it must be placed near the least virtual runtime here.
+    if (fair_scheduling) {
+        PlaceNearMinVruntime(recipient);
+        if (VruntimeBefore(donor->vruntime, recipient->vruntime)) {
+            recipient->vruntime = donor->vruntime;
+        }
+        return;
+    }
+
+    // Without the donor's level, the recipient would just be preempted by the donor on the next
+    // tick.
+    if (SchedulerEffectiveLevel(donor) < recipient->priority_level) {
+        recipient->priority_level = SchedulerEffectiveLevel(donor);
+    }
+    recipient->slice_ticks_left = donor->slice_ticks_left;
+    GiveFreshSlice(donor);
+}
+
+/*
+  Makes the given running proc ready behind every other ready proc at its effective priority
+  level, keeping the rest of its time slice. With fair_scheduling, moves its virtual runtime
+  past that of the next ready proc instead. The caller must then switch to the next proc.
+*/
+void SchedulerYield(PCB *proc) {
+    assert(proc != idle_proc);
+
+    if (fair_scheduling) {
+        // Otherwise, a proc with the least virtual runtime would just be picked again.
+        PCB *next_proc = RunHeapPeekMin(run_heap);
+        if (next_proc && !VruntimeBefore(next_proc->vruntime, proc->vruntime)) {
+            proc->vruntime = next_proc->vruntime + 1;
+        }
+    }
+
+    SchedulerMakeReady(proc);
+}
+
+/*
+  Puts the given proc to sleep until the given number of clock ticks, which must be positive,
+  have passed. The caller must then switch away from the proc.
+*/
+void SchedulerSleep(PCB *proc, unsigned int clock_ticks) {
+    assert(clock_ticks > 0);
+
+    proc->state = THEYNIX_PROC_SLEEPING;
+    proc->wake_tick = current_tick + clock_ticks;
+    ListInsertInOrder(sleeping_procs, proc, proc->pid, &WakesBefore);
+}
+
+/*
+  Wakes the given sleeping proc early, taking it out of the sleeping procs without making it
+  ready. Returns false if the proc wasn't sleeping.
+*/
+bool SchedulerCancelSleep(PCB *proc) {
+    return ListRemoveById(sleeping_procs, proc->pid) != NULL;
+}
+
+/*
+  Counts a clock tick and makes every proc whose sleep is over ready. Then charges the current
+  proc for the tick and ages the ready queues. A proc whose time slice runs out is demoted and
+  given a fresh slice. Returns true if the current proc should be put back in a ready queue and
+  another proc switched to.
+*/
+bool SchedulerTick() {
+    current_tick++;
+
+    // Tickless idle: while only the idle proc can run, a tick does nothing until the first
+    // sleeping proc is due. There is nothing to age, and idle has no time slice.
+    if (current_proc == idle_proc && num_ready_procs == 0 && !SleepingProcDue()) {
+        return false;
+    }
+
+    WakeSleepingProcs();
+
+    if (fair_scheduling) {
+        return FairTick();
+    }
+
+    ticks_since_aging++;
+    if (ticks_since_aging >= AGING_INTERVAL_TICKS) {
+        AgeReadyQueues();
+        ticks_since_aging = 0;
+    }
+
+    // The idle proc has no time slice, and is below every priority level.
+    if (current_proc == idle_proc) {
+        return num_ready_procs > 0;
+    }
+
+    // Preempt for a proc of higher priority, without charging the rest of the slice.
+    if (ProcReadyAtOrAbove(SchedulerEffectiveLevel(current_proc) - 1)) {
+        return true;
+    }
+
+    assert(current_proc->slice_ticks_left > 0);
+    current_proc->slice_ticks_left--;
+    if (current_proc->slice_ticks_left > 0) {
+        return false;
+    }
+
+    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Proc %d used up its time slice at level %d\n",
+        current_proc->pid, current_proc->priority_level);
+    if (current_proc->priority_level < BOTTOM_PRIORITY_LEVEL) {
+        current_proc->priority_level++;
+    }
+    GiveFreshSlice(current_proc);
+
+    // If no other proc is ready to take a turn, keep running without a context switch.
+    return ProcReadyAtOrAbove(SchedulerEffectiveLevel(current_proc));
+}
+
+/*
+  Charges the current proc for a clock tick under the fair scheduler. Returns true once the
+  current proc's virtual runtime is a quantum ahead of the least virtual runtime of the ready
+  procs, or if the idle proc is running and any proc is ready.
+*/
+bool FairTick() {
+    if (current_proc == idle_proc) {
+        UpdateMinVruntime();
+        return num_ready_procs > 0;
+    }
+
+    current_proc->vruntime += VRUNTIME_PER_TICK * DEFAULT_PRIORITY_WEIGHT
+        / EffectiveWeight(current_proc);
+    UpdateMinVruntime();
+
+    PCB *next_proc = RunHeapPeekMin(run_heap);
+    return next_proc && !VruntimeBefore(current_proc->vruntime,
+        next_proc->vruntime + base_quantum_ticks * VRUNTIME_PER_TICK);
+}
+
+/*
+  Returns the weight the given proc's virtual runtime grows by: the higher of its own and the
+  weight it inherits from the waiters on its locks.
+*/
+unsigned int EffectiveWeight(PCB *proc) {
+    if (proc->inherited_weight > SchedulerWeight(proc)) {
+        return proc->inherited_weight;
+    }
+    return SchedulerWeight(proc);
+}
+
+/*
+  If the given proc has fallen more than a quantum behind the least virtual runtime, e.g. because
+  it was blocked, moves it up to a quantum behind, so that it runs soon but can't take over the
+  CPU to catch up.
+*/
+void PlaceNearMinVruntime(PCB *proc) {
+    unsigned int earliest_vruntime = min_vruntime - base_quantum_ticks * VRUNTIME_PER_TICK;
+    if (VruntimeBefore(proc->vruntime, earliest_vruntime)) {
+        proc->vruntime = earliest_vruntime;
+    }
+}
+
+/*
+  Moves min_vruntime up to the least virtual runtime of the running proc and the ready procs.
+*/
+void UpdateMinVruntime() {
+    PCB *min_proc = RunHeapPeekMin(run_heap);
+    if (current_proc != idle_proc
+            && (!min_proc || VruntimeBefore(current_proc->vruntime, min_proc->vruntime))) {
+        min_proc = current_proc;
+    }
+
+    if (min_proc && VruntimeBefore(min_vruntime, min_proc->vruntime)) {
+        min_vruntime = min_proc->vruntime;
+    }
+}
+
+/*
+  Returns whether the wake tick of the proc at the front of the sleeping procs, which is the
+  next proc to wake, has come.
+*/
+bool SleepingProcDue() {
+    PCB *proc = (PCB *) ListPeak(sleeping_procs);
+    return proc && (int) (proc->wake_tick - current_tick) <= 0;
+}
+
+/*
+  Makes ready each proc at the front of the sleeping procs whose wake tick has come.
+*/
+void WakeSleepingProcs() {
+    while (SleepingProcDue()) {
+        PCB *proc = (PCB *) ListDequeue(sleeping_procs);
+        TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Proc %d done sleeping\n", proc->pid);
+        SchedulerMakeReady(proc);
+    }
+}
+
+/*
+  Passed to ListInsertInOrder() to keep the sleeping procs sorted by wake tick. Compares the
+  ticks relative to the current tick, so the order survives the tick count wrapping around.
+*/
+bool WakesBefore(void *new_proc, void *proc) {
+    return ((PCB *) new_proc)->wake_tick - current_tick < ((PCB *) proc)->wake_tick - current_tick;
+}
+
+/*
+  Sets the proc's time slice to the quantum of its priority level, scaled by its weight. Every
+  slice is at least a tick.
+*/
+void GiveFreshSlice(PCB *proc) {
+    unsigned int quantum = base_quantum_ticks << proc->priority_level;
+    proc->slice_ticks_left = quantum * SchedulerWeight(proc) / DEFAULT_PRIORITY_WEIGHT;
+    if (proc->slice_ticks_left == 0) {
+        proc->slice_ticks_left = 1;
+    }
+}
+
+/*
+  Returns whether any proc is ready at the given priority level or a higher one, i.e. a lower
+  numbered one.
+*/
+bool ProcReadyAtOrAbove(int priority_level) {
+    int i;
+    for (i = TOP_PRIORITY_LEVEL; i <= priority_level; i++) {
+        if (!ListEmpty(ready_queues[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+  Passed to ListMap() over a lock's waiting procs. Keeps the highest effective priority level and
+  weight of the waiters in highest_waiter_level and highest_waiter_weight.
+*/
+void FindHighestWaiterLevel(void *_waiter) {
+    int level = SchedulerEffectiveLevel((PCB *) _waiter);
+    if (level < highest_waiter_level) {
+        highest_waiter_level = level;
+    }
+
+    unsigned int weight = EffectiveWeight((PCB *) _waiter);
+    if (weight > highest_waiter_weight) {
+        highest_waiter_weight = weight;
+    }
+}
+
+/*
+  Passed to ListMap() over a proc's owned locks.
+*/
+void FindHighestWaiterLevelOfLock(void *_lock) {
+    ListMap(((Lock *) _lock)->waiting_procs, &FindHighestWaiterLevel);
+}
+
+/*
+  Moves every ready proc, and the current proc, back to the top priority level with a fresh
+  time slice, keeping the ready procs in the order they became ready.
+*/
+void AgeReadyQueues() {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> AgeReadyQueues()\n");
+
+    int i;
+    for (i = TOP_PRIORITY_LEVEL + 1; i <= BOTTOM_PRIORITY_LEVEL; i++) {
+        PCB *proc;
+        while ((proc = (PCB *) ListDequeue(ready_queues[i]))) {
+            num_ready_procs--;
+            proc->priority_level = TOP_PRIORITY_LEVEL;
+            GiveFreshSlice(proc);
+            SchedulerMakeReady(proc);
+        }
+    }
+
+    if (current_proc != idle_proc) {
+        current_proc->priority_level = TOP_PRIORITY_LEVEL;
+        GiveFreshSlice(current_proc);
+    }
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< AgeReadyQueues()\n");
+}
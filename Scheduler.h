@@ -0,0 +1,159 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <stdbool.h>
+
+#include "PCB.h"
+
+/*
+ * Scheduler.h
+ * A multi-level feedback queue, or a fair scheduler, that decides which ready proc runs next.
+ *
+ * There is a FIFO ready queue for each priority level, and level 0 is the highest. The next proc
+ * to run is always taken from the highest non-empty level. Each proc has a time slice of clock
+ * ticks, which is the quantum of its level: base_quantum_ticks at level 0, doubling with each
+ * level down. The clock only preempts a proc once its slice runs out, or when a proc of higher
+ * priority is ready, so a proc running alone is never switched out.
+ *
+ * A proc that uses up its whole slice is demoted a level, and a proc that blocks waiting on a
+ * terminal, a pipe or a lock is promoted a level. Every AGING_INTERVAL_TICKS clock ticks, every
+ * ready proc is moved back to level 0 so that demoted procs can't starve.
+ *
+ * Each proc also has a scheduling priority set with SetPriority(), which gives it a weight.
+ * Its time slices are its level's quantum scaled by its weight over the default weight, so that
+ * among procs at the same level, each gets a share of the CPU in proportion to its weight.
+ *
+ * A proc that owns a lock runs at the highest level of the procs waiting for it, if that is
+ * higher than its own, so that procs of lower priority than the waiters can't hold it up. This
+ * priority inheritance passes along chains of procs waiting on locks owned by waiting procs.
+ *
+ * With the sched=cfs boot option, the fair scheduler is used instead. Each proc has a virtual
+ * runtime, which grows with every tick it runs, by less the more weight it has, and the ready
+ * proc with the least virtual runtime runs next, taken from a min-heap. The running proc is
+ * preempted once it is a quantum of virtual runtime ahead of that proc. A proc that wakes up
+ * after blocking gets at most a quantum of credit, so that it runs soon but can't take over the
+ * CPU to catch up. Priority inheritance passes on weights instead of levels.
+ *
+ * Procs that called Delay() sleep in a list sorted by the absolute clock tick they wake at, with
+ * a hash table on pid. Each tick only looks at the front of the list, so it does constant work
+ * plus the work of waking the procs that are due, and a sleep can be cancelled in constant time.
+ *
+ * While only the idle proc can run, a clock tick just counts itself until the front of the
+ * sleeping procs is due, and then switches straight to the proc that woke.
+ */
+
+#define NUM_PRIORITY_LEVELS 4
+#define TOP_PRIORITY_LEVEL 0
+#define BOTTOM_PRIORITY_LEVEL (NUM_PRIORITY_LEVELS - 1)
+
+// The default quantum of level 0, in clock ticks, and the largest that can be set at boot.
+#define DEFAULT_QUANTUM_TICKS 1
+#define MAX_QUANTUM_TICKS 1000
+
+#define AGING_INTERVAL_TICKS 20
+
+#define SLEEPING_PROCS_HASH_TABLE_SIZE 32
+#define READY_QUEUE_HASH_TABLE_SIZE 32
+
+#define DEFAULT_PRIORITY_WEIGHT 1024
+
+// The virtual runtime a proc of the default weight gains in a clock tick.
+#define VRUNTIME_PER_TICK 1024
+
+/*
+  Allocates the ready queues.
+*/
+void InitializeScheduler();
+
+/*
+  Starts a new proc at the priority level, scheduling priority and virtual runtime of the given
+  parent, or at the top level, the default priority and min_vruntime if parent is NULL, with a
+  fresh time slice. Children don't start ahead of their parents, so that forking can't be used
+  to climb back to the top level or to the front of the run heap.
+*/
+void SchedulerInitProc(PCB *proc, PCB *parent);
+
+/*
+  Sets the given proc's scheduling priority, which must be in range. Its next time slice is
+  scaled by the new weight.
+*/
+void SchedulerSetPriority(PCB *proc, int priority);
+
+/*
+  Returns the scheduling weight of the given proc's priority. Procs of the default priority have
+  weight DEFAULT_PRIORITY_WEIGHT.
+*/
+unsigned int SchedulerWeight(PCB *proc);
+
+/*
+  Adds the given proc to the back of the ready queue for its effective priority level.
+*/
+void SchedulerMakeReady(PCB *proc);
+
+/*
+  Takes the given proc out of the ready queues. Returns false if it wasn't ready.
+*/
+bool SchedulerRemoveReady(PCB *proc);
+
+/*
+  Returns the level the given proc is scheduled at: the higher of its own priority level and the
+  level it inherits from the waiters on its locks.
+*/
+int SchedulerEffectiveLevel(PCB *proc);
+
+/*
+  Recomputes the priority level the given proc inherits from the procs waiting on the locks it
+  owns. Must be called whenever a lock's owner or waiters change. If the proc's effective level
+  changes, moves it to its new ready queue if it is ready, and passes the change on to the owner
+  of the lock it is waiting for, if any.
+*/
+void SchedulerUpdateInheritedPriority(PCB *proc);
+
+/*
+  Removes and returns the proc at the front of the highest non-empty ready queue, or returns NULL
+  if no proc is ready.
+*/
+PCB *SchedulerNextProc();
+
+/*
+  Promotes the given proc a priority level, because it is about to block waiting on I/O or a
+  lock, and gives it a fresh time slice.
+*/
+void SchedulerBoost(PCB *proc);
+
+/*
+  Gives the rest of the donor's time slice, and its priority level if that is higher, to the
+  recipient, which the donor is about to switch straight to. The donor gets a fresh slice for
+  its next turn.
+*/
+void SchedulerDonateSlice(PCB *donor, PCB *recipient);
+
+/*
+  Makes the given running proc ready behind every other ready proc at its effective priority
+  level, keeping the rest of its time slice. With fair_scheduling, moves its virtual runtime
+  past that of the next ready proc instead. The caller must then switch to the next proc.
+*/
+void SchedulerYield(PCB *proc);
+
+/*
+  Puts the given proc to sleep until the given number of clock ticks, which must be positive,
+  have passed. The caller must then switch away from the proc.
+*/
+void SchedulerSleep(PCB *proc, unsigned int clock_ticks);
+
+/*
+  Wakes the given sleeping proc early, taking it out of the sleeping procs without making it
+  ready. Returns false if the proc wasn't sleeping.
+*/
+bool SchedulerCancelSleep(PCB *proc);
+
+/*
+  Counts a clock tick and makes every proc whose sleep is over ready. Then charges the current
+  proc for the tick and ages the ready queues. A proc whose time slice
+  runs out is demoted and given a fresh slice. Returns true if the current proc should be put
+  back in a ready queue and another proc switched to: i.e. its slice ran out while another proc
+  of the same or higher priority is ready, or a proc of higher priority is ready.
+*/
+bool SchedulerTick();
+
+#endif
@@ -0,0 +1,43 @@
+#include "Sem.h"
+
+#include <stdlib.h>
+
+#include "Kernel.h"
+
+/*
+ * Sem.c
+ * Counting semaphores
+ *
+ * This file contains code for initializing and freeing
+ * semaphores.
+ */
+
+extern unsigned int next_synch_resource_id;
+
+/*
+  Constructs a new semaphore with the given initial value.
+*/
+Sem *SemNewSem(int value) {
+    Sem *sem = calloc(1, sizeof(Sem));
+    if (!sem) {
+        return NULL;
+    }
+
+    sem->id = next_synch_resource_id++;
+    sem->value = value;
+    // Look up by ID when a waiting proc is killed
+    sem->waiting_procs = ListNewList(WAITING_PROCS_HASH_TABLE_SIZE);
+
+    return sem;
+}
+
+/*
+  Free the semaphore.
+
+  The list of waiting processes must be empty.
+*/
+void SemDestroy(Sem *sem) {
+    ListDestroy(sem->waiting_procs);
+
+    free(sem);
+}
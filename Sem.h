@@ -0,0 +1,39 @@
+#ifndef _SEM_H_
+#define _SEM_H_
+
+#include "List.h"
+#include "PCB.h"
+
+/*
+ * Sem.h
+ * Counting semaphores
+ *
+ * This file contains code for initializing and freeing
+ * semaphores.
+ */
+
+struct Sem {
+    int id;
+
+    // The number of SemDown() calls that can return without blocking
+    int value;
+
+    // Procs blocked in SemDown(), woken in the order they arrived
+    List *waiting_procs;
+};
+
+typedef struct Sem Sem;
+
+/*
+  Constructs a new semaphore with the given initial value.
+*/
+Sem *SemNewSem(int value);
+
+/*
+  Free the semaphore.
+
+  The list of waiting processes must be empty.
+*/
+void SemDestroy(Sem *sem);
+
+#endif
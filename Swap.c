@@ -0,0 +1,432 @@
+#include "Swap.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "Kernel.h"
+#include "Log.h"
+#include "PageOps.h"
+#include "PMem.h"
+#include "Scheduler.h"
+#include "VMem.h"
+
+/*
+ * Swap.c
+ * A pager that swaps region 1 pages out to the disk when physical memory runs out.
+ */
+
+/*
+  A request to read or write one page of a swap slot. The disk only does one sector at a time,
+  so a request is done after SECTORS_PER_PAGE disk interrupts. Requests are served in FIFO order,
+  so a page that is swapped back in right after being swapped out is read after it is written.
+*/
+typedef struct SwapRequest SwapRequest;
+struct SwapRequest {
+    bool in_use;
+
+    // DISK_READ or DISK_WRITE
+    int op;
+    unsigned int slot;
+    unsigned int sectors_done;
+
+    // Page aligned, so it can be filled and emptied with PageCopy().
+    char *buffer;
+
+    // For reads, the proc waiting for its page and the frame the page will be copied into.
+    PCB *pcb;
+    unsigned int page_num;
+    unsigned int pfn;
+
+    SwapRequest *next;
+};
+
+SwapRequest swap_requests[NUM_SWAP_BUFFERS];
+
+// The request at the head of the queue is the one on the disk.
+SwapRequest *disk_queue_head;
+SwapRequest *disk_queue_tail;
+
+// The number of pages that are in each slot, and the number of requests in flight for each slot.
+// A slot is free when both are 0.
+unsigned int slot_ref_counts[NUM_SWAP_SLOTS];
+unsigned int slot_num_requests[NUM_SWAP_SLOTS];
+
+// The next frame the clock hand will look at.
+unsigned int clock_hand;
+
+// Procs waiting in SwapWaitForIo() for the next request to finish.
+List *swap_waiting_procs;
+
+/*    Private Function Prototypes     */
+int SwapOutOnePage();
+bool IsSwappable(PCB *owner, unsigned int page_num, unsigned int frame);
+SwapRequest *TakeSwapRequest();
+int TakeSwapSlot();
+void QueueSwapRequest(SwapRequest *request);
+void StartDiskAccess(SwapRequest *request);
+
+/*
+  Allocates the pager's buffers and bookkeeping. Must be called after physical memory
+  management is initialized.
+*/
+void InitializeSwap() {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> InitializeSwap()\n");
+
+    // One allocation for every buffer, with an extra page to align them with.
+    char *buffers = (char *) malloc((NUM_SWAP_BUFFERS + 1) * PAGESIZE);
+    if (!buffers) {
+        TracePrintf(TRACE_LEVEL_TERMINAL_PROBLEM, "Could not allocate the swap buffers!\n");
+        Halt();
+    }
+    buffers = (char *) UP_TO_PAGE(buffers);
+
+    unsigned int i;
+    for (i = 0; i < NUM_SWAP_BUFFERS; i++) {
+        swap_requests[i].in_use = false;
+        swap_requests[i].buffer = buffers + i * PAGESIZE;
+    }
+
+    disk_queue_head = NULL;
+    disk_queue_tail = NULL;
+    clock_hand = 0;
+    swap_waiting_procs = ListNewList(WAITING_PROCS_HASH_TABLE_SIZE);
+
+    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "%d swap slots of %d sectors.\n", NUM_SWAP_SLOTS,
+            SECTORS_PER_PAGE);
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< InitializeSwap()\n");
+}
+
+/*
+  Frees count frames by swapping out pages of procs other than the current one. Never blocks.
+  Returns ERROR if count frames could not be freed, though some may have been.
+*/
+int SwapOutPages(unsigned int count) {
+    unsigned int i;
+    for (i = 0; i < count; i++) {
+        if (SwapOutOnePage() == ERROR) {
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Could only swap out %u of %u pages.\n",
+                    i, count);
+            return ERROR;
+        }
+    }
+    return SUCCESS;
+}
+
+/*
+  Blocks the current proc until at least count frames are unused, swapping out pages of other
+  procs and waiting for the disk whenever every swap buffer is in flight. Returns ERROR if that
+  many frames can't be freed, e.g. because every swap slot is full.
+*/
+int SwapReserveFrames(unsigned int count, UserContext *user_context) {
+    while (GetNumFreeFrames() < count) {
+        // Once the disk is idle, every buffer is free, so a failure is final.
+        if (SwapOutOnePage() == ERROR && !SwapWaitForIo(user_context)) {
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Could only free %u of %u frames.\n",
+                    GetNumFreeFrames(), count);
+            return ERROR;
+        }
+    }
+    return SUCCESS;
+}
+
+/*
+  Reads the given swapped out page of the current proc back into a new frame and maps it with its
+  old protections, blocking the proc until the read is done. Returns ERROR if no frame can be
+  found for it.
+*/
+int SwapInPage(PCB *pcb, unsigned int page_num, UserContext *user_context) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> SwapInPage(%u)\n", page_num);
+    assert(pcb == current_proc);
+    assert(!pcb->region_1_page_table[page_num].valid);
+    assert(pcb->region_1_page_info[page_num].swapped);
+
+    // Leave this proc's pages alone while it is blocked here, so the pages the kernel has
+    // already validated for it stay put.
+    pcb->waiting_on_swap = true;
+
+    // Get a frame for the page, waiting for the disk if every frame and buffer is taken.
+    struct pte frame_pte;
+    while (GetUnusedFrame(&frame_pte) == ERROR) {
+        if (!SwapWaitForIo(user_context)) {
+            pcb->waiting_on_swap = false;
+            return ERROR;
+        }
+    }
+
+    // Get a buffer to read into. If they're all taken, they're all in flight.
+    SwapRequest *request;
+    while (!(request = TakeSwapRequest())) {
+        SwapWaitForIo(user_context);
+    }
+
+    request->op = DISK_READ;
+    request->slot = pcb->region_1_page_info[page_num].swap_slot;
+    request->pcb = pcb;
+    request->page_num = page_num;
+    request->pfn = frame_pte.pfn;
+    QueueSwapRequest(request);
+
+    // SwapDiskInterrupt() maps the page and makes us ready once it has been read.
+    SwitchToNextProc(user_context);
+    pcb->waiting_on_swap = false;
+
+    assert(pcb->region_1_page_table[page_num].valid);
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< SwapInPage()\n\n");
+    return SUCCESS;
+}
+
+/*
+  If any disk request is in flight, blocks the current proc until one finishes, when frames or
+  buffers may have been freed, and returns true. Otherwise returns false right away.
+*/
+bool SwapWaitForIo(UserContext *user_context) {
+    if (!disk_queue_head) {
+        return false;
+    }
+
+    bool was_waiting_on_swap = current_proc->waiting_on_swap;
+    current_proc->waiting_on_swap = true;
+
+    ListAppend(swap_waiting_procs, current_proc, current_proc->pid);
+    current_proc->wait_list = swap_waiting_procs;
+    SwitchToNextProc(user_context);
+
+    current_proc->waiting_on_swap = was_waiting_on_swap;
+    return true;
+}
+
+/*
+  Puts back the protections the clock hand took away from the given valid page.
+*/
+void SwapRestoreClockPage(PCB *pcb, unsigned int page_num) {
+    assert(pcb->region_1_page_info[page_num].clock_revoked);
+
+    pcb->region_1_page_table[page_num].prot = pcb->region_1_page_info[page_num].saved_prot;
+    pcb->region_1_page_info[page_num].clock_revoked = false;
+    if (pcb == current_proc) {
+        WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE + (page_num << PAGESHIFT));
+    }
+}
+
+/*
+  Adds a reference to the given swap slot.
+*/
+void SwapRetainSlot(unsigned int slot) {
+    assert(slot < NUM_SWAP_SLOTS);
+    assert(slot_ref_counts[slot] > 0);
+
+    slot_ref_counts[slot]++;
+}
+
+/*
+  Releases a reference to the given swap slot. The slot is reused once it has no references and
+  no request in flight.
+*/
+void SwapReleaseSlot(unsigned int slot) {
+    assert(slot < NUM_SWAP_SLOTS);
+    assert(slot_ref_counts[slot] > 0);
+
+    slot_ref_counts[slot]--;
+}
+
+/*
+  Handles the completion of the disk operation that is in flight: starts the next sector of the
+  request, or finishes the request and starts the next one.
+*/
+void SwapDiskInterrupt() {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> SwapDiskInterrupt()\n");
+    SwapRequest *request = disk_queue_head;
+    assert(request);
+
+    request->sectors_done++;
+    if (request->sectors_done < SECTORS_PER_PAGE) {
+        StartDiskAccess(request);
+        TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< SwapDiskInterrupt()\n");
+        return;
+    }
+
+    // The request is done, so take it off the queue and start the next one. This must happen
+    // before any proc is made ready: that can grow the kernel heap and swap out a page, which
+    // queues a request and starts the disk itself if the queue is empty.
+    disk_queue_head = request->next;
+    if (!disk_queue_head) {
+        disk_queue_tail = NULL;
+    } else {
+        StartDiskAccess(disk_queue_head);
+    }
+    slot_num_requests[request->slot]--;
+
+    if (request->op == DISK_READ) {
+        PCB *pcb = request->pcb;
+        struct pte *pte = &pcb->region_1_page_table[request->page_num];
+        PageInfo *info = &pcb->region_1_page_info[request->page_num];
+
+        // Fill the frame reserved for the page and map it with its old protections.
+        void *frame_addr = MapTempFrame(request->pfn);
+        PageCopy(frame_addr, request->buffer);
+        UnmapTempFrame(frame_addr);
+
+        pte->pfn = request->pfn;
+        pte->prot = info->saved_prot;
+        pte->valid = 1;
+        info->swapped = false;
+        SetFrameOwner(request->pfn, pcb, request->page_num);
+        AddFramesHeld(pcb, 1);
+        SwapReleaseSlot(request->slot);
+
+        SchedulerMakeReady(pcb);
+    }
+    request->in_use = false;
+
+    // A buffer, and maybe a slot, is free now, so let everyone waiting on the disk try again.
+    while (!ListEmpty(swap_waiting_procs)) {
+        PCB *waiting_proc = (PCB *) ListDequeue(swap_waiting_procs);
+        SchedulerMakeReady(waiting_proc);
+    }
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< SwapDiskInterrupt()\n");
+}
+
+/*
+  Runs the clock hand until it finds a page to swap out, and swaps it out. Returns ERROR if there
+  is no free buffer or slot to swap it out to, or no page can be swapped out.
+*/
+int SwapOutOnePage() {
+    SwapRequest *request = TakeSwapRequest();
+    if (!request) {
+        return ERROR;
+    }
+    int slot = TakeSwapSlot();
+    if (slot == ERROR) {
+        request->in_use = false;
+        return ERROR;
+    }
+
+    // Two sweeps are enough to take away the protections of every page and then come back
+    // around to the first one.
+    unsigned int num_frames = GetNumFrames();
+    unsigned int steps;
+    for (steps = 0; steps < 2 * num_frames; steps++) {
+        unsigned int frame = clock_hand;
+        clock_hand = (clock_hand + 1) % num_frames;
+
+        unsigned int page_num;
+        PCB *owner = GetFrameOwner(frame, &page_num);
+        if (!IsSwappable(owner, page_num, frame)) {
+            continue;
+        }
+
+        struct pte *pte = &owner->region_1_page_table[page_num];
+        PageInfo *info = &owner->region_1_page_info[page_num];
+
+        // Give the page until the hand comes back around to be touched. The owner isn't
+        // running, so its region 1 isn't in the TLB.
+        if (!info->clock_revoked) {
+            info->saved_prot = pte->prot;
+            pte->prot = PROT_NONE;
+            info->clock_revoked = true;
+            continue;
+        }
+
+        TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Swapping out page %u of proc %d to slot %d\n",
+                page_num, owner->pid, slot);
+
+        // Copy the page out so its frame can be freed now, while the write happens later.
+        void *frame_addr = MapTempFrame(frame);
+        PageCopy(request->buffer, frame_addr);
+        UnmapTempFrame(frame_addr);
+
+        pte->valid = 0;
+        info->clock_revoked = false;
+        info->swapped = true;
+        info->swap_slot = slot;
+        slot_ref_counts[slot] = 1;
+        ReleaseUsedFrame(frame);
+        AddFramesHeld(owner, -1);
+
+        request->op = DISK_WRITE;
+        request->slot = slot;
+        request->pcb = NULL;
+        QueueSwapRequest(request);
+        return SUCCESS;
+    }
+
+    request->in_use = false;
+    return ERROR;
+}
+
+/*
+  Returns whether the given frame is a private page of a proc that can be swapped out now.
+*/
+bool IsSwappable(PCB *owner, unsigned int page_num, unsigned int frame) {
+    // The idle proc must never block, so it has to keep all of its pages.
+    if (!owner || owner == current_proc || owner == idle_proc) {
+        return false;
+    }
+
+    // Procs that have never run may be having their region 1 loaded by the kernel right now.
+    if (!owner->kernel_context_initialized || owner->waiting_on_swap) {
+        return false;
+    }
+
+    // Frames shared by a fork can't be found from every page table that maps them.
+    if (GetFrameRefCount(frame) != 1) {
+        return false;
+    }
+
+    struct pte *pte = &owner->region_1_page_table[page_num];
+    return pte->valid && pte->pfn == frame;
+}
+
+/*
+  Returns a request that isn't in use, marked as in use, or NULL if every one is.
+*/
+SwapRequest *TakeSwapRequest() {
+    unsigned int i;
+    for (i = 0; i < NUM_SWAP_BUFFERS; i++) {
+        if (!swap_requests[i].in_use) {
+            swap_requests[i].in_use = true;
+            return &swap_requests[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+  Returns a slot with no pages in it and no request in flight, or ERROR if there is none.
+*/
+int TakeSwapSlot() {
+    unsigned int i;
+    for (i = 0; i < NUM_SWAP_SLOTS; i++) {
+        if (slot_ref_counts[i] == 0 && slot_num_requests[i] == 0) {
+            return i;
+        }
+    }
+    return ERROR;
+}
+
+/*
+  Adds the given request to the end of the disk queue, starting it if the disk is idle.
+*/
+void QueueSwapRequest(SwapRequest *request) {
+    request->sectors_done = 0;
+    request->next = NULL;
+    slot_num_requests[request->slot]++;
+
+    if (disk_queue_tail) {
+        disk_queue_tail->next = request;
+        disk_queue_tail = request;
+    } else {
+        disk_queue_head = request;
+        disk_queue_tail = request;
+        StartDiskAccess(request);
+    }
+}
+
+/*
+  Starts the disk operation for the next sector of the given request.
+*/
+void StartDiskAccess(SwapRequest *request) {
+    DiskAccess(request->op, request->slot * SECTORS_PER_PAGE + request->sectors_done,
+            request->buffer + request->sectors_done * SECTORSIZE);
+}
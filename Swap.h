@@ -0,0 +1,89 @@
+#ifndef _SWAP_H_
+#define _SWAP_H_
+
+#include <stdbool.h>
+
+#include "hardware.h"
+#include "PCB.h"
+
+/*
+ * Swap.h
+ * A pager that swaps region 1 pages out to the disk when physical memory runs out.
+ *
+ * The disk is split into slots of SECTORS_PER_PAGE sectors, each holding one page. Victims are
+ * chosen by a clock hand that sweeps physical frames: the first time the hand passes a page it
+ * takes away all of the page's protections, and if the page hasn't been touched (putting the
+ * protections back) by the next time around, it is swapped out. Only private frames of procs
+ * other than the current one are swapped out, so the kernel can always use the current proc's
+ * pages once they have been validated.
+ *
+ * Swapping out never blocks: the page is copied into a kernel buffer and its frame is freed right
+ * away, while the buffer is written to the disk in the background. Swapping in blocks the proc
+ * until its page has been read.
+ */
+
+#define SECTORS_PER_PAGE (PAGESIZE / SECTORSIZE)
+#define NUM_SWAP_SLOTS (NUMSECTORS / SECTORS_PER_PAGE)
+
+// The number of page buffers for requests to the disk, and thus the number of requests that
+// can be in flight at once.
+#define NUM_SWAP_BUFFERS 4
+
+// The frames a syscall reserves with SwapReserveFrames() for the kernel heap to grow into, on top
+// of the frames it maps itself. A malloc() can't block to wait for the disk.
+#define SWAP_KERNEL_HEAP_RESERVE 2
+
+/*
+  Allocates the pager's buffers and bookkeeping. Must be called after physical memory
+  management is initialized.
+*/
+void InitializeSwap();
+
+/*
+  Frees count frames by swapping out pages of procs other than the current one. Never blocks.
+  Returns ERROR if count frames could not be freed, though some may have been.
+*/
+int SwapOutPages(unsigned int count);
+
+/*
+  Blocks the current proc until at least count frames are unused, swapping out pages of other
+  procs and waiting for the disk whenever every swap buffer is in flight. Returns ERROR if that
+  many frames can't be freed, e.g. because every swap slot is full.
+*/
+int SwapReserveFrames(unsigned int count, UserContext *user_context);
+
+/*
+  Reads the given swapped out page of the current proc back into a new frame and maps it with its
+  old protections, blocking the proc until the read is done. Returns ERROR if no frame can be
+  found for it.
+*/
+int SwapInPage(PCB *pcb, unsigned int page_num, UserContext *user_context);
+
+/*
+  If any disk request is in flight, blocks the current proc until one finishes, when frames or
+  buffers may have been freed, and returns true. Otherwise returns false right away.
+*/
+bool SwapWaitForIo(UserContext *user_context);
+
+/*
+  Puts back the protections the clock hand took away from the given valid page.
+*/
+void SwapRestoreClockPage(PCB *pcb, unsigned int page_num);
+
+/*
+  Adds a reference to the given swap slot, e.g. because a forked child's page is also in it.
+*/
+void SwapRetainSlot(unsigned int slot);
+
+/*
+  Releases a reference to the given swap slot. The slot is reused once it has no references and
+  no request in flight.
+*/
+void SwapReleaseSlot(unsigned int slot);
+
+/*
+  Handles the completion of the disk operation that is in flight.
+*/
+void SwapDiskInterrupt();
+
+#endif
@@ -13,6 +13,10 @@
 #include "PMem.h"
 #include "VMem.h"
 #include "Pipe.h"
+#include "Scheduler.h"
+#include "Sem.h"
+#include "Swap.h"
+#include "TheynixCalls.h"
 
 /*
  * SystemCalls.h
@@ -21,14 +25,81 @@
  * They behave (hopefully) as the spec indicates.
  */
 
-extern List *clock_block_procs;
 extern List *waiting_on_children_procs;
-extern List *ready_queue;
+
+// The number of bytes in the pipe that KernelPipeWrite() is looking for a reader for.
+int pipe_chars_available;
+
+/*    Private Function Prototypes     */
+void ReleaseLock(Lock *lock, PCB *owner, UserContext *user_context);
+void GiveSemUnit(Sem *sem, UserContext *user_context);
+
+/* Scheduling helper methods */
+
+// Puts the given proc, which the current proc just woke up, on the ready queue. With the
+// handoff boot option, the current proc instead goes on the ready queue, donates the rest of its
+// time slice to the woken proc, and switches straight to it. Never switches if user_context is
+// NULL.
+void WakeProc(PCB *woken_proc, UserContext *user_context) {
+    if (!handoff_on_wake || !user_context || current_proc == idle_proc) {
+        SchedulerMakeReady(woken_proc);
+        return;
+    }
+
+    TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Proc %d handing off to proc %d\n", current_proc->pid,
+        woken_proc->pid);
+    SchedulerDonateSlice(current_proc, woken_proc);
+    SchedulerMakeReady(current_proc);
+    SwitchToProc(woken_proc, user_context);
+}
 
 /* Input Validate helper methods */
 
 // For the given page, return true if it has the specified permissions
 bool ValidatePage(unsigned int page, unsigned long permissions) {
+    // The pager took away the page's protections to see whether it is still in use, and it is.
+    if (current_proc->region_1_page_table[page].valid
+            && current_proc->region_1_page_info[page].clock_revoked) {
+        SwapRestoreClockPage(current_proc, page);
+    }
+
+    // The page was swapped out, so read it back in. This blocks, but none of this proc's pages
+    // are swapped out in the meantime, so the pages validated before this one stay valid.
+    if (!current_proc->region_1_page_table[page].valid
+            && current_proc->region_1_page_info[page].swapped) {
+        UserContext user_context = current_proc->user_context;
+        if (SwapInPage(current_proc, page, &user_context) == ERROR) {
+            return false;
+        }
+    }
+
+    // The kernel is about to touch a page of the program that hasn't been loaded yet,
+    // so load it now.
+    if (!current_proc->region_1_page_table[page].valid
+            && current_proc->region_1_page_info[page].lazy) {
+        if (LoadLazyPage(current_proc, page) == ERROR) {
+            return false;
+        }
+    }
+
+    // The kernel is about to touch a heap page that has been reserved but not yet mapped,
+    // so map it now.
+    if (!current_proc->region_1_page_table[page].valid
+            && page >= current_proc->user_heap_start_page && page < current_proc->user_brk_page) {
+        if (MapDemandZeroPage(current_proc, page) == ERROR) {
+            return false;
+        }
+    }
+
+    // The kernel is about to write to a page that is only read-only until it's copied,
+    // so copy it now.
+    if ((permissions & PROT_WRITE) && current_proc->region_1_page_table[page].valid
+            && current_proc->region_1_page_info[page].copy_on_write) {
+        if (BreakCopyOnWrite(current_proc, page) == ERROR) {
+            return false;
+        }
+    }
+
     bool valid = current_proc->region_1_page_table[page].valid == 1;
     bool has_permissions = (current_proc->region_1_page_table[page].prot & permissions)
          == permissions;
@@ -48,8 +119,15 @@ bool ValidateUserArg(unsigned int arg, int num_bytes, unsigned long permissions)
 
     // get relative page for region 1 from arg addr
     int start_page = ADDR_TO_PAGE(arg - VMEM_1_BASE);
-    // how far does this memory span?
-    int finish_page = start_page + (num_bytes >> PAGESHIFT);
+    // how far does this memory span? (the last byte may be on the page after
+    // start_page + num_bytes / PAGESIZE if arg isn't page aligned)
+    int finish_page = start_page;
+    if (num_bytes > 0) {
+        finish_page = ADDR_TO_PAGE(arg + num_bytes - 1 - VMEM_1_BASE);
+    }
+    if (finish_page >= NUM_PAGES_REG_1) {
+        return false;
+    }
     int i;
     for (i = start_page; i <= finish_page; i++) {
         if (!ValidatePage(i, permissions)) {
@@ -92,6 +170,12 @@ int KernelFork(UserContext *user_context) {
     // Save the current user context.
     current_proc->user_context = *user_context;
 
+    // Free frames for the child's kernel stack first, while we can still wait for the disk.
+    if (SwapReserveFrames(NUM_KERNEL_PAGES + SWAP_KERNEL_HEAP_RESERVE, user_context) == ERROR) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Out of frames for fork child.\n");
+        return ERROR;
+    }
+
     // Make a new child PCB with the same user context as the parent.
     PCB *child_pcb = NewBlankPCBWithPageTables(current_proc->user_context);
 
@@ -101,16 +185,16 @@ int KernelFork(UserContext *user_context) {
     }
 
     child_pcb->waiting_on_children = false;
+    SchedulerInitProc(child_pcb, current_proc);
 
     // copy data about address space
     child_pcb->lowest_user_stack_page = current_proc->lowest_user_stack_page;
     child_pcb->user_brk_page = current_proc->user_brk_page;
+    child_pcb->user_heap_start_page = current_proc->user_heap_start_page;
 
-    // Copy over region 1.
-    if (CopyRegion1PageTableAndData(current_proc, child_pcb) == ERROR) {
-        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Could not copy region 1 page table and data.\n");
-        return ERROR;
-    }
+    // Share region 1 with the child copy-on-write. Pages are only copied once one of us
+    // writes to them.
+    ShareRegion1PageTable(current_proc, child_pcb);
 
     // Add the child to the parent's child list
     ListAppend(current_proc->live_children, child_pcb, child_pcb->pid);
@@ -123,7 +207,7 @@ int KernelFork(UserContext *user_context) {
 
     // Set kernel_context_initialized to false and context switch to
     // child so that the KernelContext and kernel stack are copied from parent.
-    ListAppend(ready_queue, current_proc, current_proc->pid);
+    SchedulerMakeReady(current_proc);
     child_pcb->kernel_context_initialized = false;
     SwitchToProc(child_pcb, user_context);
 
@@ -141,18 +225,17 @@ int KernelFork(UserContext *user_context) {
     return 0;
 }
 
-int KernelExec(char *filename, char **argvec, UserContext *user_context_ptr) {
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelExec()\n");
+// Validate the filename string and the argvec string array given to exec or spawn, and copy
+// them into the kernel heap, so they survive region 1 being replaced. The heap argvec is NULL
+// terminated, or NULL if argvec was. Returns ERROR, with nothing left allocated, if any of them
+// is not readable by the user program.
+int CopyProgramArgsToKernelHeap(char *filename, char **argvec, char **heap_filename_ptr,
+        char ***heap_argvec_ptr) {
     if (!ValidateUserString(filename)) {
         TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Invalid filename str for exec\n");
         return ERROR;
     }
 
-    // Copy the filename string and arguments to the Kernel heap.
-    int filename_len = strlen(filename);
-    char *heap_filename = calloc(filename_len + 1, sizeof(char));
-    strncpy(heap_filename, filename, filename_len);
-
     char **heap_argvec = NULL;
     int num_args = 0;
 
@@ -197,10 +280,43 @@ int KernelExec(char *filename, char **argvec, UserContext *user_context_ptr) {
         }
     }
 
+    // Copy the filename string to the Kernel heap.
+    int filename_len = strlen(filename);
+    char *heap_filename = calloc(filename_len + 1, sizeof(char));
+    strncpy(heap_filename, filename, filename_len);
+
+    *heap_filename_ptr = heap_filename;
+    *heap_argvec_ptr = heap_argvec;
+    return SUCCESS;
+}
+
+// Free the filename string and arguments copied by CopyProgramArgsToKernelHeap().
+void FreeProgramArgs(char *heap_filename, char **heap_argvec) {
+    free(heap_filename);
+    if (heap_argvec) {
+        int i;
+        for (i = 0; heap_argvec[i]; i++) {
+            free(heap_argvec[i]);
+        }
+        free(heap_argvec);
+    }
+}
+
+int KernelExec(char *filename, char **argvec, UserContext *user_context_ptr) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelExec()\n");
+
+    // Copy the filename string and arguments to the Kernel heap.
+    char *heap_filename;
+    char **heap_argvec;
+    if (CopyProgramArgsToKernelHeap(filename, argvec, &heap_filename, &heap_argvec) == ERROR) {
+        return ERROR;
+    }
+
     // Create the new region 1 page table, loading the executable text from the given file.
     // LoadProgram() also frees the entire region 1 before recreating it for the new program.
     if (LoadProgram(heap_filename, heap_argvec, current_proc) == ERROR) {
       TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "LoadProgram() failed.\n");
+      FreeProgramArgs(heap_filename, heap_argvec);
       return ERROR;
     }
 
@@ -208,15 +324,7 @@ int KernelExec(char *filename, char **argvec, UserContext *user_context_ptr) {
     *user_context_ptr = current_proc->user_context;
 
     // Free the filename string and arguments in the Kernel heap.
-    free(heap_filename);
-    if (heap_argvec) {
-        int i;
-        for (i = 0; i < num_args; i++) {
-            char *heap_arg = heap_argvec[i];
-            free(heap_arg);
-        }
-        free(heap_argvec);
-    }
+    FreeProgramArgs(heap_filename, heap_argvec);
 
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelExec()\n\n");
 
@@ -224,114 +332,399 @@ int KernelExec(char *filename, char **argvec, UserContext *user_context_ptr) {
     return SUCCESS;
 }
 
-// Documentation notes:
-// If the process currently owns any locks, we will release them
-void KernelExit(int status, UserContext *user_context) {
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelExit(%p)\n", user_context);
-    // If initial process, halt system
-    if (current_proc->pid == INIT_PID) {
-        TracePrintf(TRACE_LEVEL_TERMINAL_PROBLEM, "Init Proc exited w/ status %d. Halting!\n", 
-            status);
-        Halt();
+int KernelSpawn(char *filename, char **argvec, UserContext *user_context) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelSpawn()\n");
+
+    // Copy the filename string and arguments to the Kernel heap, since we will switch
+    // to the child's region 1 to load it.
+    char *heap_filename;
+    char **heap_argvec;
+    if (CopyProgramArgsToKernelHeap(filename, argvec, &heap_filename, &heap_argvec) == ERROR) {
+        return ERROR;
     }
 
+    // Make a new child PCB with a blank region 1. Nothing of the parent's is copied. Free frames
+    // for its kernel stack first, while we can still wait for the disk.
+    current_proc->user_context = *user_context;
+    if (SwapReserveFrames(NUM_KERNEL_PAGES + SWAP_KERNEL_HEAP_RESERVE, user_context) == ERROR) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Out of frames for spawn child.\n");
+        FreeProgramArgs(heap_filename, heap_argvec);
+        return ERROR;
+    }
+    PCB *child_pcb = NewBlankPCBWithPageTables(current_proc->user_context);
+    if (!child_pcb) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Error creating spawn child PCB.\n");
+        FreeProgramArgs(heap_filename, heap_argvec);
+        return ERROR;
+    }
+    SchedulerInitProc(child_pcb, current_proc);
+
+    // LoadProgram() writes the program through region 1, so point the TLB at the child's region 1
+    // page table while loading, then point it back.
+    UseRegion1ForProc(child_pcb);
+    int rc = LoadProgram(heap_filename, heap_argvec, child_pcb);
+    UseRegion1ForProc(current_proc);
+
+    FreeProgramArgs(heap_filename, heap_argvec);
+
+    if (rc != SUCCESS) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "LoadProgram() failed.\n");
+        FreeUnstartedPCB(child_pcb);
+        return ERROR;
+    }
+
+    // Add the child to the parent's child list
+    ListAppend(current_proc->live_children, child_pcb, child_pcb->pid);
+
+    // Set child's parent pointer
+    child_pcb->live_parent = current_proc;
+
+    // Record the child's PID for later comparison.
+    unsigned int child_pid = child_pcb->pid;
+
+    // Context switch to the child right away so its KernelContext and kernel stack are copied
+    // from a path that knows how to return to it.
+    SchedulerMakeReady(current_proc);
+    child_pcb->kernel_context_initialized = false;
+    SwitchToProc(child_pcb, user_context);
+
+    // The child starts at the program's entry point, so its return value is never seen.
+    if (child_pid == current_proc->pid) {
+        TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelSpawn() [child: pid = %d] \n\n",
+            current_proc->pid);
+        return 0;
+    }
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelSpawn() [parent: pid = %d] \n\n",
+        current_proc->pid);
+    return child_pid;
+}
+
+// Returns the current proc if it has the given pid, or else its live child with the given pid,
+// or NULL if there is none. These are the procs whose scheduling priority the current proc may
+// see and change.
+PCB *FindSelfOrLiveChild(int pid) {
+    PCB *proc = FindProc(pid);
+    if (proc == current_proc) {
+        return proc;
+    }
+    if (proc && proc->live_parent == current_proc && proc->state != THEYNIX_PROC_ZOMBIE) {
+        return proc;
+    }
+    return NULL;
+}
+
+int KernelSetPriority(int pid, int priority) {
+    if (priority < THEYNIX_PRIORITY_MIN || priority > THEYNIX_PRIORITY_MAX) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Priority %d is out of range.\n", priority);
+        return ERROR;
+    }
+
+    PCB *proc = FindSelfOrLiveChild(pid);
+    if (!proc) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Proc %d is not me or my live child.\n", pid);
+        return ERROR;
+    }
+
+    SchedulerSetPriority(proc, priority);
+
+    // The owner of the lock it waits for runs at the priority of its waiters
+    if (proc->blocked_on_lock) {
+        SchedulerUpdateInheritedPriority(proc->blocked_on_lock->owner);
+    }
+    return SUCCESS;
+}
+
+int KernelGetPriority(int pid) {
+    PCB *proc = FindSelfOrLiveChild(pid);
+    if (!proc) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Proc %d is not me or my live child.\n", pid);
+        return ERROR;
+    }
+
+    return proc->sched_priority;
+}
+
+int KernelGetProcStats(int pid, ProcStats *stats_ptr) {
+    PCB *proc = FindSelfOrLiveChild(pid);
+    if (!proc) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Proc %d is not me or my live child.\n", pid);
+        return ERROR;
+    }
+    if (!ValidateUserArg((unsigned int) stats_ptr, sizeof(ProcStats), PROT_WRITE)) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
+            "Stats pointer passed to KernelGetProcStats() is not writable by the user program.\n");
+        return ERROR;
+    }
+
+    *stats_ptr = proc->stats;
+    stats_ptr->voluntary_switches = proc->num_switches_out - proc->stats.involuntary_switches;
+    return SUCCESS;
+}
+
+int KernelListProcs(ProcInfo *buf, int max) {
+    if (max < 0) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Negative max passed to KernelListProcs().\n");
+        return ERROR;
+    }
+    if (max > MAX_PROCS) {
+        max = MAX_PROCS;
+    }
+    if (!ValidateUserArg((unsigned int) buf, max * sizeof(ProcInfo), PROT_WRITE)) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
+            "Buffer passed to KernelListProcs() is not writable by the user program.\n");
+        return ERROR;
+    }
+
+    int num_procs = 0;
+    int pid;
+    for (pid = 0; pid < MAX_PROCS && num_procs < max; pid++) {
+        PCB *proc = FindProc(pid);
+        if (!proc) {
+            continue;
+        }
+
+        ProcInfo *info = &buf[num_procs];
+        info->pid = proc->pid;
+        info->parent_pid = proc->live_parent ? proc->live_parent->pid : -1;
+        info->state = proc->state;
+        info->priority = proc->sched_priority;
+        info->frames_held = proc->stats.frames_held;
+        info->user_ticks = proc->stats.user_ticks;
+        num_procs++;
+    }
+
+    return num_procs;
+}
+
+// Releases everything the given proc holds and hands it to its parent as a zombie with the given
+// exit status, or frees it if its parent has exited. The proc must not be in any ready, sleeping
+// or waiting list. The caller must switch away from it if it is the current proc.
+void ExitProc(PCB *proc, int status) {
     // Release system resources and free datastructures
     
     // Release any locks
-    while(!ListEmpty(current_proc->owned_lock_ids)) {
-        int lock_id = (int) ListPeak(current_proc->owned_lock_ids);
-        KernelRelease(lock_id);
+    while(!ListEmpty(proc->owned_locks)) {
+        Lock *lock = (Lock *) ListPeak(proc->owned_locks);
+        ReleaseLock(lock, proc, NULL);
+    }
+    ListDestroy(proc->owned_locks);
+
+    // Give back a semaphore unit it was handed but never got to take, unless the semaphore has
+    // been reclaimed
+    if (proc->pending_sem_id) {
+        Sem *sem = (Sem *) ListFindById(sems, proc->pending_sem_id);
+        proc->pending_sem_id = 0;
+        if (sem) {
+            GiveSemUnit(sem, NULL);
+        }
     }
-    ListDestroy(current_proc->owned_lock_ids);
 
     // Empty out child lists
-    while (!ListEmpty(current_proc->live_children)) {
-        PCB* child = (PCB *) ListDequeue(current_proc->live_children);
+    while (!ListEmpty(proc->live_children)) {
+        PCB* child = (PCB *) ListDequeue(proc->live_children);
         // Set parent pointers of children to null
         child->live_parent = NULL;
     }
-    ListDestroy(current_proc->live_children);
+    ListDestroy(proc->live_children);
 
-    while (!ListEmpty(current_proc->zombie_children)) {
-        PCB* child = (PCB *) ListDequeue(current_proc->zombie_children);
-        free(child);
+    while (!ListEmpty(proc->zombie_children)) {
+        PCB* child = (PCB *) ListDequeue(proc->zombie_children);
+        FreePCB(child);
     }
-    ListDestroy(current_proc->zombie_children);
+    ListDestroy(proc->zombie_children);
 
     // Save exit status
-    current_proc->exit_status = status;
+    proc->exit_status = status;
+    proc->state = THEYNIX_PROC_ZOMBIE;
 
     // clean up any the rest of the buffers
-    free(current_proc->tty_receive_buffer);
-    free(current_proc->tty_transmit_buffer);
+    free(proc->tty_receive_buffer);
+    free(proc->tty_transmit_buffer);
 
     // Free all frames
-    FreeRegion1PageTable(current_proc);
-    free(current_proc->region_1_page_table);
+    FreeRegion1PageTable(proc);
+    DestroyRegion1PageTable(proc);
 
-    FreeRegion0StackPages(current_proc);
-    free(current_proc->kernel_stack_page_table);
+    FreeRegion0StackPages(proc);
+    free(proc->kernel_stack_page_table);
 
     // If has a parent, move proc to zombie_children list of parent
-    if (current_proc->live_parent) {
-        ListRemoveById(current_proc->live_parent->live_children, current_proc->pid);
-        ListAppend(current_proc->live_parent->zombie_children, current_proc, current_proc->pid);
-        // If parent is waiting_on_children, move parent proc to ready queue
+    if (proc->live_parent) {
+        ListRemoveById(proc->live_parent->live_children, proc->pid);
+        ListAppend(proc->live_parent->zombie_children, proc, proc->pid);
+        // If parent is waiting_on_children, for us or any child, move parent proc to ready queue
         // reset waiting_on_chilrden
-        if (current_proc->live_parent->waiting_on_children) {
-            current_proc->live_parent->waiting_on_children = false;
-            ListAppend(ready_queue, current_proc->live_parent, current_proc->live_parent->pid);
+        PCB *parent = proc->live_parent;
+        if (parent->waiting_on_children && (parent->waiting_on_child_pid == ANY_CHILD_PID
+                || parent->waiting_on_child_pid == proc->pid)) {
+            parent->waiting_on_children = false;
+            SchedulerMakeReady(parent);
         }
     } else { // If doesn't have parent, free PCB
-        free(current_proc);
+        FreePCB(proc);
+    }
+}
+
+// Documentation notes:
+// If the process currently owns any locks, we will release them
+void KernelExit(int status, UserContext *user_context) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelExit(%p)\n", user_context);
+    // If initial process, halt system
+    if (current_proc->pid == INIT_PID) {
+        TracePrintf(TRACE_LEVEL_TERMINAL_PROBLEM, "Init Proc exited w/ status %d. Halting!\n", 
+            status);
+        Halt();
     }
 
+    ExitProc(current_proc, status);
+
     // Context switch
     SwitchToNextProc(user_context);
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelExit()\n");
 }
 
+// Returns whether the given proc is the one a terminal is transmitting from right now.
+bool IsTransmitting(PCB *proc) {
+    int i;
+    for (i = 0; i < NUM_TERMINALS; i++) {
+        if (proc->wait_list == ttys[i].waiting_to_transmit) {
+            return ListPeak(proc->wait_list) == proc;
+        }
+    }
+    return false;
+}
+
+int KernelKill(int pid, UserContext *user_context) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelKill(%d)\n", pid);
+    PCB *proc = FindProc(pid);
+    if (!proc || proc->state == THEYNIX_PROC_ZOMBIE) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "No live proc %d to kill.\n", pid);
+        return ERROR;
+    }
+    if (proc == idle_proc || proc->pid == INIT_PID) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Proc %d can't be killed.\n", pid);
+        return ERROR;
+    }
+
+    // A child that has never run is still being built by Fork() or Spawn(), which may be blocked
+    // on the pager, and isn't linked to its parent yet.
+    if (!proc->kernel_context_initialized) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Proc %d hasn't started yet.\n", pid);
+        return ERROR;
+    }
+
+    // Killing myself is just exiting
+    if (proc == current_proc) {
+        KernelExit(ERROR, user_context);
+    }
+
+    // The pager may be reading into a frame for it or holding a frame or buffer for it, or a
+    // terminal may be transmitting from its buffer. Those finish soon, so it exits once they have.
+    if (proc->waiting_on_swap || IsTransmitting(proc)) {
+        TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Proc %d will be killed after its I/O.\n", pid);
+        proc->killed = true;
+        return SUCCESS;
+    }
+
+    // Take it out of whatever it is waiting in
+    if (proc->state == THEYNIX_PROC_READY) {
+        SchedulerRemoveReady(proc);
+    } else if (proc->state == THEYNIX_PROC_SLEEPING) {
+        SchedulerCancelSleep(proc);
+    } else if (proc->wait_list) {
+        ListRemoveById(proc->wait_list, proc->pid);
+        proc->wait_list = NULL;
+    }
+
+    // Its lock's owner no longer needs to run at its priority
+    if (proc->blocked_on_lock) {
+        PCB *owner = proc->blocked_on_lock->owner;
+        proc->blocked_on_lock = NULL;
+        SchedulerUpdateInheritedPriority(owner);
+    }
+
+    ExitProc(proc, ERROR);
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelKill()\n");
+    return SUCCESS;
+}
+
 int KernelWait(int *status_ptr, UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelWait(%p)\n", user_context);
+
+    if (KernelWaitPid(ANY_CHILD_PID, status_ptr, 0, user_context) == ERROR) {
+        return ERROR;
+    }
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelWait()\n");
+    return SUCCESS;
+}
+
+int KernelWaitPid(int pid, int *status_ptr, int flags, UserContext *user_context) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelWaitPid(%d)\n", pid);
     if (!ValidateUserArg((unsigned int) status_ptr, sizeof(int), PROT_WRITE)) {
         TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Invalid status ptr in wait\n");
         return ERROR;
     }
-
-    // First check for any zombie children
-    // If zombie children list is not empty, collect exit status of one, 
-    // remove PCB from list, and free
-    if (!ListEmpty(current_proc->zombie_children)) {
-        PCB *child = (PCB *) ListDequeue(current_proc->zombie_children);
-        *status_ptr = child->exit_status;
-        // Since zombie, the page tables and children lists should have
-        // already been freed, so only free PCB
-        free(child);
-        return SUCCESS;
+    if (flags & ~THEYNIX_WNOHANG) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Invalid flags %d in wait\n", flags);
+        return ERROR;
     }
 
-    // No zombies, so check for live children
-    // If no live children, return error
-    if (ListEmpty(current_proc->live_children)) {
-        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "No live or zombie children to wait for!\n");
-        return ERROR;
+    // First check for the zombie child, or any zombie child
+    // If found, collect exit status, remove PCB from list, and free
+    PCB *child;
+    if (pid == ANY_CHILD_PID) {
+        child = (PCB *) ListDequeue(current_proc->zombie_children);
+    } else {
+        child = (PCB *) ListRemoveById(current_proc->zombie_children, pid);
     }
 
-    // Block and run the next proc
-    current_proc->waiting_on_children = true;
-    SwitchToNextProc(user_context);
+    if (!child) {
+        // No zombie, so check for the live child, or any live child
+        // If there isn't one, return error
+        bool has_live_child = (pid == ANY_CHILD_PID)
+            ? !ListEmpty(current_proc->live_children)
+            : ListFindById(current_proc->live_children, pid) != NULL;
+        if (!has_live_child) {
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "No live or zombie child to wait for!\n");
+            return ERROR;
+        }
+
+        if (flags & THEYNIX_WNOHANG) {
+            TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelWaitPid() [no zombie yet]\n");
+            return 0;
+        }
+
+        // Block and run the next proc. Only the child we wait for wakes us.
+        current_proc->waiting_on_children = true;
+        current_proc->waiting_on_child_pid = pid;
+        SwitchToNextProc(user_context);
+
+        // Our pages may have been swapped out while we were blocked.
+        if (!ValidateUserArg((unsigned int) status_ptr, sizeof(int), PROT_WRITE)) {
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Invalid status ptr in wait\n");
+            return ERROR;
+        }
+
+        // When executed again, the child must have died and put us on ready queue
+        if (pid == ANY_CHILD_PID) {
+            child = (PCB *) ListDequeue(current_proc->zombie_children);
+        } else {
+            child = (PCB *) ListRemoveById(current_proc->zombie_children, pid);
+        }
+        assert(child);
+    }
 
-    // When executed again, some child must have died and put us on ready queue
-    PCB *child = (PCB *) ListDequeue(current_proc->zombie_children);
-    assert(child);
     *status_ptr = child->exit_status;
+    int child_pid = child->pid;
     // Since zombie, the page tables and children lists should have
     // already been freed, so only free PCB
-    free(child);
+    FreePCB(child);
 
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelWait()\n");
-    // Return the exit status
-    return SUCCESS;
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelWaitPid()\n");
+    return child_pid;
 }
 
 int KernelGetPid(void) {
@@ -351,18 +744,19 @@ int KernelBrk(void *addr) {
         return ERROR;
     }
 
-    if (new_user_brk_page > current_proc->user_brk_page) { // growing the user heap...
-        int rc = MapNewRegion1Pages(current_proc, current_proc->user_brk_page,
-                new_user_brk_page - current_proc->user_brk_page, PROT_READ | PROT_WRITE);
-        if (rc == ERROR) {
-            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
-                    "MapNewRegion1Pages() failed.\n");
-            return ERROR;
-        }
-    } else if (new_user_brk_page < current_proc->user_brk_page) { // shrinking the heap...
-        UnmapRegion1Pages(current_proc, new_user_brk_page,
+    // Ensure we aren't freeing the program's data.
+    if (new_user_brk_page < current_proc->user_heap_start_page) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
+                "Address passed to KernelBrk() (%p) is below the start of the heap.\n", addr);
+        return ERROR;
+    }
+
+    // Growing the heap only reserves the new pages; TrapMemory() maps each one when it is
+    // first touched.
+    if (new_user_brk_page < current_proc->user_brk_page) { // shrinking the heap...
+        UnmapTouchedRegion1Pages(current_proc, new_user_brk_page,
                 current_proc->user_brk_page - new_user_brk_page);
-    } // New page is the same as old, so do nothing!
+    } // Otherwise, there is nothing to map yet.
 
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelBrk()\n\n");
     current_proc->user_brk_page = new_user_brk_page;
@@ -381,11 +775,8 @@ int KernelDelay(int clock_ticks, UserContext *user_context) {
         return SUCCESS;
     }
 
-    // Set clock ticks remaining to clock_ticks
-    current_proc->clock_ticks_until_ready = clock_ticks;
-
-    // Put proc in list of clock blocked
-    ListEnqueue(clock_block_procs, current_proc, current_proc->pid);
+    // Put proc in the sleeping procs until clock_ticks ticks from now
+    SchedulerSleep(current_proc, clock_ticks);
 
     SwitchToNextProc(user_context);
 
@@ -394,6 +785,17 @@ int KernelDelay(int clock_ticks, UserContext *user_context) {
     return SUCCESS;
 }
 
+int KernelYield(UserContext *user_context) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> KernelYield()\n");
+
+    // Go behind the other ready procs. If none is ready, this switches straight back to us.
+    SchedulerYield(current_proc);
+    SwitchToNextProc(user_context);
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< KernelYield()\n");
+    return SUCCESS;
+}
+
 int KernelTtyRead(int tty_id, void *buf, int len, UserContext *user_context) {
     // Make sure the id exists!
     if (tty_id < 0 || tty_id >= NUM_TERMINALS) {
@@ -440,14 +842,22 @@ int KernelTtyRead(int tty_id, void *buf, int len, UserContext *user_context) {
     // Otherwise, add proc to TTY waiting to receive queue, set tty_receive_len,
     // alloc receive buffer, and context switch!
     ListEnqueue(term.waiting_to_receive, current_proc, current_proc->pid);
+    current_proc->wait_list = term.waiting_to_receive;
     current_proc->tty_receive_len = len;
     current_proc->tty_receive_buffer = calloc(len, sizeof(char));
+    SchedulerBoost(current_proc);
     SwitchToNextProc(user_context);
 
     // When control returns here, the process copies tty_recieve_buf to buf, frees tty_receive_buf,
-    // and returns tty_receive_len.
+    // and returns tty_receive_len. Our pages may have been swapped out while we were blocked.
+    if (!ValidateUserArg((unsigned int) buf, len, PROT_WRITE)) {
+        free(current_proc->tty_receive_buffer);
+        current_proc->tty_receive_buffer = NULL;
+        return ERROR;
+    }
     memcpy(buf, current_proc->tty_receive_buffer, current_proc->tty_receive_len);
     free(current_proc->tty_receive_buffer);
+    current_proc->tty_receive_buffer = NULL;
 
     return current_proc->tty_receive_len;
 }
@@ -473,6 +883,7 @@ int KernelTtyWriteInternal(int tty_id, void *buf, int len, UserContext *user_con
 
     // Enqueue self in waiting to transmit for TTY
     ListEnqueue(term.waiting_to_transmit, current_proc, current_proc->pid);
+    current_proc->wait_list = term.waiting_to_transmit;
 
     // If I'm the only one, call TtyTransmit with len = min(TERMINAL_MAX_LINE, tty_transmit_len)
     if (queue_prev_empty) {
@@ -554,14 +965,28 @@ int KernelPipeRead(int pipe_id, void *buf, int len, UserContext *user_context) {
 
     // Block until there are enough chars available
     while (p->num_chars_available < len) {
-        ListAppend(p->waiting_to_read, current_proc, len);
+        ListAppend(p->waiting_to_read, current_proc, current_proc->pid);
+        current_proc->wait_list = p->waiting_to_read;
+        current_proc->pipe_read_len = len;
+        SchedulerBoost(current_proc);
         SwitchToNextProc(user_context);
+
+        // Our pages may have been swapped out while we were blocked.
+        if (!ValidateUserArg((unsigned int) buf, len, PROT_WRITE)) {
+            return ERROR;
+        }
     }
 
     // Use Pipe helper method to copy from pipe into user buf
     return PipeCopyIntoUserBuffer(p, buf, len);
 }
 
+// Passed to ListRemoveFirstMatch() over a pipe's waiting readers. Returns whether the reader
+// waits for no more than pipe_chars_available bytes.
+bool CanReadFromPipe(void *_reader) {
+    return ((PCB *) _reader)->pipe_read_len <= pipe_chars_available;
+}
+
 int KernelPipeWrite(int pipe_id, void *buf, int len, UserContext *user_context) {
     if (len < 0) {
         return ERROR;
@@ -604,10 +1029,10 @@ int KernelPipeWrite(int pipe_id, void *buf, int len, UserContext *user_context)
     PipeCopyIntoPipeBuffer(p, buf, len);
 
     // If another proc is waiting and enough characters available, move him to ready
-    PCB *next_proc = (PCB *) ListFindFirstLessThanIdAndRemove(p->waiting_to_read, 
-        p->num_chars_available);
+    pipe_chars_available = p->num_chars_available;
+    PCB *next_proc = (PCB *) ListRemoveFirstMatch(p->waiting_to_read, &CanReadFromPipe);
     if (next_proc) {
-        ListAppend(ready_queue, next_proc, next_proc->pid);
+        SchedulerMakeReady(next_proc);
     }
 
     // Return len
@@ -648,31 +1073,36 @@ int KernelAcquire(int lock_id, UserContext *user_context) {
     }
 
     // If I already have the lock, do nothing and return.
-    if (lock->acquired && lock->owner_id == current_proc->pid) {
+    if (lock->acquired && lock->owner == current_proc) {
         return SUCCESS;
     }
 
     // If the lock is available, take it and return.
     if (!lock->acquired) {
         lock->acquired = true;
-        lock->owner_id = current_proc->pid;
-        ListEnqueue(current_proc->owned_lock_ids, (void *) lock->id, lock->id);
+        lock->owner = current_proc;
+        ListEnqueue(current_proc->owned_locks, lock, lock->id);
         return SUCCESS;
     }
 
-    // Otherwise, add ourselves to waiting queue for the lock
-    // and context switch.
+    // Otherwise, add ourselves to waiting queue for the lock, lend our priority to the owner
+    // so that it can't be held up by procs of lower priority than us, and context switch.
     ListEnqueue(lock->waiting_procs, (void *) current_proc, current_proc->pid);
+    current_proc->wait_list = lock->waiting_procs;
+    SchedulerBoost(current_proc);
+    current_proc->blocked_on_lock = lock;
+    SchedulerUpdateInheritedPriority(lock->owner);
     SwitchToNextProc(user_context);
 
     // Once we return, we have the lock and are out of the waiting procs list!
-    assert(lock->owner_id == current_proc->pid);
+    assert(lock->owner == current_proc);
     assert(lock->acquired);
-    assert(ListFindById(current_proc->owned_lock_ids, lock->id));
+    assert(ListFindById(current_proc->owned_locks, lock->id));
+    assert(!current_proc->blocked_on_lock);
     return SUCCESS;
 }
 
-int KernelRelease(int lock_id) {
+int KernelRelease(int lock_id, UserContext *user_context) {
     // Find the lock.
     Lock *lock = (Lock *) ListFindById(locks, lock_id);
 
@@ -683,28 +1113,38 @@ int KernelRelease(int lock_id) {
     }
 
     // Ensure that I currently own the lock.
-    if (!lock->acquired || lock->owner_id != current_proc->pid) {
+    if (!lock->acquired || lock->owner != current_proc) {
         TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "I don't own lock %d.\n", lock_id);
         return ERROR;
     }
 
-    // Remove lock from list of owned
-    void *released_lock = ListRemoveById(current_proc->owned_lock_ids, lock->id);
+    ReleaseLock(lock, current_proc, user_context);
+    return SUCCESS;
+}
+
+// Releases the given lock, which the given proc owns, and gives it to the next waiting proc, if
+// any. That proc is woken with WakeProc(), so user_context may be NULL.
+void ReleaseLock(Lock *lock, PCB *owner, UserContext *user_context) {
+    // Remove lock from list of owned, and stop running at the priority of its waiters
+    void *released_lock = ListRemoveById(owner->owned_locks, lock->id);
     assert(released_lock); // If it wasn't in there, something went wrong!
+    SchedulerUpdateInheritedPriority(owner);
 
     // If there are no processes waiting on the lock, mark it as available and return.
     if (ListEmpty(lock->waiting_procs)) {
         lock->acquired = false;
-        return SUCCESS;
+        lock->owner = NULL;
+        return;
     }
 
     // Pop a process from the waiting queue, give the lock to it, and put it on the ready queue.
+    // It inherits the priority of the procs still waiting.
     PCB *unblocked_proc = (PCB *) ListDequeue(lock->waiting_procs);
-    lock->owner_id = unblocked_proc->pid;
-    ListEnqueue(unblocked_proc->owned_lock_ids, (void *) lock->id, lock->id);
-    ListEnqueue(ready_queue, unblocked_proc, unblocked_proc->pid);
-
-    return SUCCESS;
+    lock->owner = unblocked_proc;
+    unblocked_proc->blocked_on_lock = NULL;
+    ListEnqueue(unblocked_proc->owned_locks, lock, lock->id);
+    SchedulerUpdateInheritedPriority(unblocked_proc);
+    WakeProc(unblocked_proc, user_context);
 }
 
 int KernelCvarInit(int *cvar_idp) {
@@ -727,7 +1167,7 @@ int KernelCvarInit(int *cvar_idp) {
     return SUCCESS;
 }
 
-int KernelCvarSignal(int cvar_id) {
+int KernelCvarSignal(int cvar_id, UserContext *user_context) {
     // Find the cvar.
     CVar *cvar = (CVar *) ListFindById(cvars, cvar_id);
 
@@ -744,7 +1184,7 @@ int KernelCvarSignal(int cvar_id) {
 
     // Remove a process from the waiting queue and put it on the ready queue.
     PCB *waiting_proc = ListDequeue(cvar->waiting_procs);
-    ListEnqueue(ready_queue, waiting_proc, waiting_proc->pid);
+    WakeProc(waiting_proc, user_context);
 
     return SUCCESS;
 }
@@ -762,7 +1202,7 @@ int KernelCvarBroadcast(int cvar_id) {
     // For each proc in cvar wait queue, remove and add to ready queue
     while (!ListEmpty(cvar->waiting_procs)) {
         PCB *waiting_proc = ListDequeue(cvar->waiting_procs);
-        ListEnqueue(ready_queue, waiting_proc, waiting_proc->pid);
+        SchedulerMakeReady(waiting_proc);
     }
 
     return SUCCESS;
@@ -779,13 +1219,14 @@ int KernelCvarWait(int cvar_id, int lock_id, UserContext *user_context) {
     }
 
     // Release the lock. If I get any errors, return ERROR.
-    if (KernelRelease(lock_id) == ERROR) {
+    if (KernelRelease(lock_id, NULL) == ERROR) {
         TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Releasing lock %d failed.\n", lock_id);
         return ERROR;
     }
 
     // Add the current proc to the cvar's list of waiting procs.
     ListEnqueue(cvar->waiting_procs, current_proc, current_proc->pid);
+    current_proc->wait_list = cvar->waiting_procs;
 
     // Context switch.
     SwitchToNextProc(user_context);
@@ -799,6 +1240,88 @@ int KernelCvarWait(int cvar_id, int lock_id, UserContext *user_context) {
     return SUCCESS;
 }
 
+int KernelSemInit(int *sem_idp, int value) {
+    if (!ValidateUserArg((unsigned int) sem_idp, sizeof(int), PROT_WRITE)) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
+            "The int pointer passed to KernelSemInit() is not writable by the user process.\n");
+        return ERROR;
+    }
+    if (value < 0) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Semaphore value %d is negative.\n", value);
+        return ERROR;
+    }
+
+    // Make a new semaphore.
+    Sem *sem = SemNewSem(value);
+    if (!sem) {
+        return ERROR;
+    }
+
+    // Save the semaphore to the list of semaphores.
+    ListEnqueue(sems, sem, sem->id);
+
+    // Save the semaphore id as a side effect.
+    *sem_idp = sem->id;
+
+    return SUCCESS;
+}
+
+int KernelSemUp(int sem_id, UserContext *user_context) {
+    // Find the semaphore.
+    Sem *sem = (Sem *) ListFindById(sems, sem_id);
+
+    // If the semaphore didn't exist, return ERROR.
+    if (!sem) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Semaphore %d does not exist.\n", sem_id);
+        return ERROR;
+    }
+
+    GiveSemUnit(sem, user_context);
+    return SUCCESS;
+}
+
+// Hands a unit of the given semaphore to the proc that has waited longest in KernelSemDown(), so
+// that a proc calling SemDown() before it runs can't take it first. If no proc is waiting, counts
+// the unit in the value instead. The waiter is woken with WakeProc(), so user_context may be NULL.
+void GiveSemUnit(Sem *sem, UserContext *user_context) {
+    if (ListEmpty(sem->waiting_procs)) {
+        sem->value++;
+        return;
+    }
+
+    PCB *waiting_proc = (PCB *) ListDequeue(sem->waiting_procs);
+    waiting_proc->pending_sem_id = sem->id;
+    WakeProc(waiting_proc, user_context);
+}
+
+int KernelSemDown(int sem_id, UserContext *user_context) {
+    // Find the semaphore.
+    Sem *sem = (Sem *) ListFindById(sems, sem_id);
+
+    // If the semaphore didn't exist, return ERROR.
+    if (!sem) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Semaphore %d does not exist.\n", sem_id);
+        return ERROR;
+    }
+
+    // If a unit is available, take it and return.
+    if (sem->value > 0) {
+        sem->value--;
+        return SUCCESS;
+    }
+
+    // Otherwise, add ourselves to the end of the waiting queue and context switch. KernelSemUp()
+    // gives us its unit when it wakes us.
+    ListEnqueue(sem->waiting_procs, current_proc, current_proc->pid);
+    current_proc->wait_list = sem->waiting_procs;
+    SchedulerBoost(current_proc);
+    SwitchToNextProc(user_context);
+
+    // The unit is ours now.
+    current_proc->pending_sem_id = 0;
+    return SUCCESS;
+}
+
 int KernelReclaim(int id) {
     // Find appropriate struct in kernel lists, remove from list, and freeeeeeeeeeeee
     Lock *l = ListRemoveById(locks, id);
@@ -823,6 +1346,18 @@ int KernelReclaim(int id) {
         return SUCCESS;
     }
 
+    Sem *s = ListFindById(sems, id);
+    if (s) { // resource was semaphore
+        if (!ListEmpty(s->waiting_procs)) { // ensure no procs are waiting
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
+                "Procs waiting on semaphore, can't free\n");
+            return ERROR;
+        }
+        ListRemoveById(sems, id);
+        SemDestroy(s);
+        return SUCCESS;
+    }
+
     Pipe *p = ListRemoveById(pipes, id);
     if (p) { //resource was pipe
         if (!ListEmpty(p->waiting_to_read)) { // ensure no one is waiting to read
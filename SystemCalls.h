@@ -3,6 +3,8 @@
 
 #include <hardware.h>
 
+#include "TheynixCalls.h"
+
 /*
  * SystemCalls.h
  *
@@ -14,18 +16,51 @@ int KernelFork(UserContext *user_context);
 
 int KernelExec(char *filename, char **argvec, UserContext *user_context_ptr);
 
+// Creates a child running the given program without copying the caller's address space,
+// i.e. Fork() and Exec() in one call. Returns the child's pid.
+int KernelSpawn(char *filename, char **argvec, UserContext *user_context);
+
+// Sets the scheduling priority (see TheynixCalls.h) of the caller or of one of its live
+// children.
+int KernelSetPriority(int pid, int priority);
+
+// Returns the scheduling priority of the caller or of one of its live children.
+int KernelGetPriority(int pid);
+
+// Copies the ProcStats (see TheynixCalls.h) of the caller or of one of its live children into
+// the user's stats_ptr.
+int KernelGetProcStats(int pid, ProcStats *stats_ptr);
+
+// Copies a ProcInfo (see TheynixCalls.h) for each proc, up to max of them, into buf. Returns the
+// number copied.
+int KernelListProcs(ProcInfo *buf, int max);
+
 // We have added the specification that a process releases any system resources
 // on exit (e.g. held locks)
 void KernelExit(int status, UserContext *user_context);
 
 int KernelWait(int *status_ptr, UserContext *user_context);
 
+// Collects the exit status of the child with the given pid, or of any child if pid is
+// ANY_CHILD_PID, blocking until it exits unless THEYNIX_WNOHANG is in flags. Returns the child's
+// pid, or 0 if it hasn't exited and THEYNIX_WNOHANG was given.
+int KernelWaitPid(int pid, int *status_ptr, int flags, UserContext *user_context);
+
+// Terminates the proc with the given pid, whatever it is doing, as if it had called Exit(ERROR).
+// A proc that the pager or a terminal is busy with exits as soon as they are done. Returns ERROR
+// for idle, init, zombies, unknown pids and children that Fork() or Spawn() is still building.
+int KernelKill(int pid, UserContext *user_context);
+
 int KernelGetPid(void);
 
 int KernelBrk(void *addr);
 
 int KernelDelay(int clock_ticks, UserContext *user_context);
 
+// Gives up the CPU to the other ready procs at the caller's priority, if there are any, without
+// sleeping for a clock tick like Delay(1).
+int KernelYield(UserContext *user_context);
+
 int KernelTtyRead(int tty_id, void *buf, int len, UserContext *user_context);
 
 // "Internal" method does not validate the args! Can only be used by the Kernel!
@@ -43,16 +78,30 @@ int KernelLockInit(int *lock_idp);
 
 int KernelAcquire(int lock_id, UserContext *user_context);
 
-int KernelRelease(int lock_id);
+// With the handoff boot option, switches straight to the waiter the lock is handed to. Pass a
+// NULL user_context to never switch, e.g. when the caller is about to block or exit.
+int KernelRelease(int lock_id, UserContext *user_context);
 
 int KernelCvarInit(int *cvar_idp);
 
-int KernelCvarSignal(int cvar_id);
+// With the handoff boot option, switches straight to the woken waiter.
+int KernelCvarSignal(int cvar_id, UserContext *user_context);
 
 int KernelCvarBroadcast(int cvar_id);
 
 int KernelCvarWait(int cvar_id, int lock_id, UserContext *user_context);
 
+// Creates a counting semaphore with the given non-negative value and stores its id in sem_idp.
+int KernelSemInit(int *sem_idp, int value);
+
+// Hands a unit to the proc that has waited longest in KernelSemDown(), if any, or else increments
+// the value. With the handoff boot option, switches straight to the woken waiter.
+int KernelSemUp(int sem_id, UserContext *user_context);
+
+// Decrements the value if it is positive. Otherwise blocks until KernelSemUp() hands this proc a
+// unit.
+int KernelSemDown(int sem_id, UserContext *user_context);
+
 int KernelReclaim(int id);
 
 #endif
@@ -0,0 +1,140 @@
+#ifndef _THEYNIX_CALLS_H_
+#define _THEYNIX_CALLS_H_
+
+#include <yalnix.h>
+
+/*
+ * TheynixCalls.h
+ * System calls that THEYNIX adds to the ones in the Yalnix spec.
+ *
+ * The user library only has stubs for Custom0(), Custom1() and Custom2(), so every
+ * THEYNIX call traps with YALNIX_CUSTOM_0 and passes the number of the call as the first
+ * argument. User programs should use the wrappers below like any other Yalnix call.
+ */
+
+/* Call Numbers */
+
+#define THEYNIX_CALL_SPAWN 1
+#define THEYNIX_CALL_SET_PRIORITY 2
+#define THEYNIX_CALL_GET_PRIORITY 3
+#define THEYNIX_CALL_YIELD 4
+#define THEYNIX_CALL_GET_PROC_STATS 5
+#define THEYNIX_CALL_LIST_PROCS 6
+#define THEYNIX_CALL_WAIT_PID 7
+#define THEYNIX_CALL_KILL 8
+
+/* WaitPid Flags */
+
+// Return 0 right away instead of blocking if the child hasn't exited yet.
+#define THEYNIX_WNOHANG 1
+
+/* Scheduling Priorities */
+
+// A proc's share of the CPU grows with its priority: among procs that all want the CPU, each
+// gets a share in proportion to its weight, which is about 25% more for each step up.
+// Children start with their parent's priority.
+#define THEYNIX_PRIORITY_MIN 0
+#define THEYNIX_PRIORITY_DEFAULT 10
+#define THEYNIX_PRIORITY_MAX 20
+
+/* Process Statistics */
+
+// Syscalls are counted by their Yalnix trap code, e.g. YALNIX_FORK, masked to the low byte.
+// Every THEYNIX call is counted under YALNIX_CUSTOM_0.
+#define THEYNIX_NUM_SYSCALL_TYPES 0x100
+#define THEYNIX_SYSCALL_TYPE(code) ((code) & (THEYNIX_NUM_SYSCALL_TYPES - 1))
+
+// What a proc has cost since it was created, as filled in by GetProcStats().
+typedef struct ProcStats ProcStats;
+struct ProcStats {
+    // Clock ticks that came while the proc was running.
+    unsigned int user_ticks;
+
+    // Traps the proc raised itself: syscalls, and memory, math and illegal instruction
+    // exceptions. Of these, the syscalls of each type, indexed with THEYNIX_SYSCALL_TYPE().
+    unsigned int kernel_traps;
+    unsigned int syscalls[THEYNIX_NUM_SYSCALL_TYPES];
+
+    // Times the proc gave up the CPU because it blocked, slept or yielded, and times it was
+    // preempted by the clock.
+    unsigned int voluntary_switches;
+    unsigned int involuntary_switches;
+
+    // Memory exceptions that were served, e.g. by growing the stack or swapping a page back in,
+    // rather than killing the proc.
+    unsigned int page_faults;
+
+    // The physical frames mapped by the proc's region 1 pages and kernel stack, now and at most.
+    // A frame shared copy-on-write counts for every proc that maps it.
+    unsigned int frames_held;
+    unsigned int peak_frames_held;
+};
+
+/* Process Listing */
+
+// The states of a proc in a ProcInfo.
+#define THEYNIX_PROC_RUNNING 0  // On the CPU.
+#define THEYNIX_PROC_READY 1    // Waiting for the CPU.
+#define THEYNIX_PROC_SLEEPING 2 // In Delay().
+#define THEYNIX_PROC_BLOCKED 3  // Waiting on anything else, e.g. a child, a lock, I/O or the pager.
+#define THEYNIX_PROC_ZOMBIE 4   // Exited, but not yet waited for.
+
+// A snapshot of one proc, as filled in by ListProcs().
+typedef struct ProcInfo ProcInfo;
+struct ProcInfo {
+    int pid;
+    // The pid of the proc's parent, or -1 if its parent has exited.
+    int parent_pid;
+    int state;
+    int priority;
+    unsigned int frames_held;
+    unsigned int user_ticks;
+};
+
+/* Wrappers */
+
+// Starts the program in filename, with the arguments in argvec as in Exec(), in a new child
+// process, without copying the caller's address space. Returns the pid of the child, or ERROR.
+#define Spawn(filename, argvec) \
+    Custom0(THEYNIX_CALL_SPAWN, (int) (filename), (int) (argvec), 0)
+
+// Sets the scheduling priority of the caller or of one of its live children, from
+// THEYNIX_PRIORITY_MIN for background work to THEYNIX_PRIORITY_MAX for latency-critical work.
+// Returns ERROR if pid isn't the caller or a live child, or the priority is out of range.
+#define SetPriority(pid, priority) \
+    Custom0(THEYNIX_CALL_SET_PRIORITY, (pid), (priority), 0)
+
+// Returns the scheduling priority of the caller or of one of its live children, or ERROR.
+#define GetPriority(pid) \
+    Custom0(THEYNIX_CALL_GET_PRIORITY, (pid), 0, 0)
+
+// Gives up the CPU to the other ready procs at the caller's priority, if there are any, and
+// returns when the caller is scheduled again. Unlike Delay(1), doesn't wait for a clock tick.
+// Returns 0.
+#define Yield() \
+    Custom0(THEYNIX_CALL_YIELD, 0, 0, 0)
+
+// Fills in the ProcStats that stats_ptr points to for the caller or one of its live children.
+// Returns ERROR if pid isn't the caller or a live child, or stats_ptr isn't writable.
+#define GetProcStats(pid, stats_ptr) \
+    Custom0(THEYNIX_CALL_GET_PROC_STATS, (pid), (int) (stats_ptr), 0)
+
+// Fills in the array of max ProcInfos that buf points to with a snapshot of every proc, live or
+// zombie, in order of pid, including the idle proc. Returns the number of procs filled in, which
+// is less than the number of procs if there are more than max, or ERROR if buf isn't writable.
+#define ListProcs(buf, max) \
+    Custom0(THEYNIX_CALL_LIST_PROCS, (int) (buf), (max), 0)
+
+// Like Wait(), but for the child with the given pid, or for any child if pid is -1. flags is 0 or
+// THEYNIX_WNOHANG. Returns the pid of the child collected, 0 if THEYNIX_WNOHANG is given and the
+// child hasn't exited yet, or ERROR if pid isn't a child of the caller.
+#define WaitPid(pid, status_ptr, flags) \
+    Custom0(THEYNIX_CALL_WAIT_PID, (pid), (int) (status_ptr), (flags))
+
+// Terminates the proc with the given pid, whether it is running, ready, delayed or blocked. Its
+// parent collects an exit status of ERROR. Returns ERROR for the idle and init procs, zombies,
+// unknown pids and children that haven't started running yet.
+#define Kill(pid) \
+    Custom0(THEYNIX_CALL_KILL, (pid), 0, 0)
+
+#endif
@@ -9,21 +9,76 @@
 #include <stdio.h>
 
 #include "Kernel.h"
+#include "LoadProgram.h"
 #include "Log.h"
 #include "PCB.h"
 #include "SystemCalls.h"
+#include "Scheduler.h"
+#include "Swap.h"
+#include "TheynixCalls.h"
+#include "VMem.h"
 
 /*
  * Traps.c
  * Contains trap table initialization and trap functions.
  */
 
-extern List *clock_block_procs;
-extern List *ready_queue;
 extern PCB *current_proc;
 
+/*    Private Function Prototypes     */
+void ExitIfKilled(UserContext *user_context);
+
+// Call the THEYNIX syscall whose number is in the first register. These all trap
+// with YALNIX_CUSTOM_0 (see TheynixCalls.h).
+int TheynixCall(UserContext *user_context) {
+    int rc;
+    switch (user_context->regs[0]) {
+        case THEYNIX_CALL_SPAWN:
+            rc = KernelSpawn((char *) user_context->regs[1],
+                (char **) user_context->regs[2], user_context);
+            break;
+        case THEYNIX_CALL_SET_PRIORITY:
+            rc = KernelSetPriority(user_context->regs[1], user_context->regs[2]);
+            break;
+        case THEYNIX_CALL_GET_PRIORITY:
+            rc = KernelGetPriority(user_context->regs[1]);
+            break;
+        case THEYNIX_CALL_YIELD:
+            rc = KernelYield(user_context);
+            break;
+        case THEYNIX_CALL_GET_PROC_STATS:
+            rc = KernelGetProcStats(user_context->regs[1], (ProcStats *) user_context->regs[2]);
+            break;
+        case THEYNIX_CALL_LIST_PROCS:
+            rc = KernelListProcs((ProcInfo *) user_context->regs[1], user_context->regs[2]);
+            break;
+        case THEYNIX_CALL_WAIT_PID:
+            rc = KernelWaitPid(user_context->regs[1], (int *) user_context->regs[2],
+                user_context->regs[3], user_context);
+            break;
+        case THEYNIX_CALL_KILL:
+            rc = KernelKill(user_context->regs[1], user_context);
+            break;
+        default:
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "TheynixCall: Call %d undefined\n",
+                user_context->regs[0]);
+            KernelExit(ERROR, user_context);
+            rc = ERROR;
+            break;
+    }
+    return rc;
+}
+
 void TrapKernel(UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> TrapKernel(%p)\n", user_context);
+
+    // Keep the PCB's copy of the user context current, so the kernel can block this proc
+    // from places that don't have the trap's user context, like ValidatePage().
+    current_proc->user_context = *user_context;
+
+    current_proc->stats.kernel_traps++;
+    current_proc->stats.syscalls[THEYNIX_SYSCALL_TYPE(user_context->code)]++;
+
     int rc;
     // Call approriate syscall based on code
     switch(user_context->code){
@@ -75,13 +130,13 @@ void TrapKernel(UserContext *user_context) {
             rc = KernelAcquire(user_context->regs[0], user_context);
             break;
         case YALNIX_LOCK_RELEASE:
-            rc = KernelRelease(user_context->regs[0]);
+            rc = KernelRelease(user_context->regs[0], user_context);
             break;
         case YALNIX_CVAR_INIT:
             rc = KernelCvarInit((int *) user_context->regs[0]);
             break;
         case YALNIX_CVAR_SIGNAL:
-            rc = KernelCvarSignal(user_context->regs[0]);
+            rc = KernelCvarSignal(user_context->regs[0], user_context);
             break;
         case YALNIX_CVAR_BROADCAST:
             rc = KernelCvarBroadcast(user_context->regs[0]);
@@ -89,9 +144,21 @@ void TrapKernel(UserContext *user_context) {
         case YALNIX_CVAR_WAIT:
             rc = KernelCvarWait(user_context->regs[0], user_context->regs[1], user_context);
             break;
+        case YALNIX_SEM_INIT:
+            rc = KernelSemInit((int *) user_context->regs[0], user_context->regs[1]);
+            break;
+        case YALNIX_SEM_UP:
+            rc = KernelSemUp(user_context->regs[0], user_context);
+            break;
+        case YALNIX_SEM_DOWN:
+            rc = KernelSemDown(user_context->regs[0], user_context);
+            break;
         case YALNIX_RECLAIM:
             rc = KernelReclaim(user_context->regs[0]);
             break;
+        case YALNIX_CUSTOM_0:
+            rc = TheynixCall(user_context);
+            break;
         default:
             TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "TrapKernel: Code %d undefined\n");
             KernelExit(ERROR, user_context);
@@ -99,45 +166,33 @@ void TrapKernel(UserContext *user_context) {
             break;
     }
     user_context->regs[0] = rc;
+    ExitIfKilled(user_context);
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< TrapKernel() rc=%d\n", rc);
 }
 
-// Method pased to ListMap on clock tick
-// decrements the number of ticks remaining for each proc that is waiting from Delay
-void DecrementTicksRemaining(void *_proc) {
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> DecrementTicksRemaining(%p)\n", _proc);
-    PCB *proc = (PCB *) _proc;
-    --proc->clock_ticks_until_ready;
-    if (proc->clock_ticks_until_ready <= 0) {
-        TracePrintf(TRACE_LEVEL_FUNCTION_INFO, 
-            ">>> DecrementTicksRemaining: proc %p done waiting!\n",
-             _proc);
-
-        ListRemoveById(clock_block_procs, proc->pid);
-        ListAppend(ready_queue, proc, proc->pid);
-    }
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< DecrementTicksRemaining()\n");
-}
-
 void TrapClock(UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> TrapClock(%p)\n", user_context);
-    // Use Map interface to decrement the ticks remaining for each proc
-    ListMap(clock_block_procs, &DecrementTicksRemaining);
-
-    // If the current proc is not the idle, place it in the ready queue
-    if (current_proc->pid != IDLE_PID) {
-        ListAppend(ready_queue, current_proc, current_proc->pid);
+    // Wake the procs whose Delay() is over. Then, once the current proc has used up its time
+    // slice, or a higher priority proc is ready, place it in the ready queue for its level, unless
+    // it is the idle proc, and switch to the next ready proc. Otherwise it keeps running without
+    // a context switch. While idle has nothing to switch to, this returns right away.
+    ExitIfKilled(user_context);
+    current_proc->stats.user_ticks++;
+    if (SchedulerTick()) {
+        if (current_proc != idle_proc) {
+            SchedulerMakeReady(current_proc);
+            current_proc->stats.involuntary_switches++;
+        }
+        SwitchToNextProc(user_context);
     }
 
-    // and switch to the next ready proc
-    SwitchToNextProc(user_context);
-
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< TrapClock(%p)\n", user_context);
 }
 
 // Print error message and kill proc
 void TrapIllegal(UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> TrapIllegal(%p)\n", user_context);
+    current_proc->stats.kernel_traps++;
     char *err_str = calloc(TERMINAL_MAX_LINE, sizeof(char));
     sprintf(err_str, "TRAP_ILLEGAL exception for proc %d\n", current_proc->pid);
     KernelTtyWriteInternal(0, err_str, strnlen(err_str, TERMINAL_MAX_LINE), user_context);
@@ -148,6 +203,7 @@ void TrapIllegal(UserContext *user_context) {
 
 void TrapMemory(UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> TrapMemory(%p)\n", user_context);
+    current_proc->stats.kernel_traps++;
 
     unsigned int addr_int = (unsigned int) user_context->addr;
 
@@ -164,7 +220,56 @@ void TrapMemory(UserContext *user_context) {
 
     // get the appropriate page in region 1
     int addr_page = ADDR_TO_PAGE(user_context->addr - VMEM_1_BASE);
-    if (current_proc->region_1_page_table[addr_page].valid != 1) { // "address not mapped"
+    bool in_heap = (addr_page >= current_proc->user_heap_start_page
+            && addr_page < current_proc->user_brk_page);
+    if (current_proc->region_1_page_table[addr_page].valid == 1
+            && current_proc->region_1_page_info[addr_page].clock_revoked) {
+        // Touched a page the pager's clock hand was watching, so it is still in use
+        SwapRestoreClockPage(current_proc, addr_page);
+    } else if (current_proc->region_1_page_table[addr_page].valid != 1
+            && current_proc->region_1_page_info[addr_page].swapped) {
+        // The page was swapped out, so read it back in
+        if (SwapInPage(current_proc, addr_page, user_context) == ERROR) {
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "SwapInPage() failed.\n");
+            char *err_str = calloc(TERMINAL_MAX_LINE, sizeof(char));
+            sprintf(err_str, "Proc %d touched a swapped out page, but out of free frames\n",
+                current_proc->pid);
+            KernelTtyWriteInternal(0, err_str, strnlen(err_str, TERMINAL_MAX_LINE), user_context);
+            free(err_str);
+            KernelExit(ERROR, user_context);
+        }
+    } else if (current_proc->region_1_page_table[addr_page].valid != 1
+            && current_proc->region_1_page_info[addr_page].lazy) {
+        // First touch of a lazily loaded text or data page, so read it from the executable
+        if (LoadLazyPage(current_proc, addr_page) == ERROR) {
+            // Frames may free up once the disk catches up, so try again then
+            if (SwapWaitForIo(user_context)) {
+                return;
+            }
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "LoadLazyPage() failed.\n");
+            char *err_str = calloc(TERMINAL_MAX_LINE, sizeof(char));
+            sprintf(err_str, "Proc %d touched its program, but it could not be loaded\n",
+                current_proc->pid);
+            KernelTtyWriteInternal(0, err_str, strnlen(err_str, TERMINAL_MAX_LINE), user_context);
+            free(err_str);
+            KernelExit(ERROR, user_context);
+        }
+    } else if (current_proc->region_1_page_table[addr_page].valid != 1 && in_heap) {
+        // First touch of a heap page reserved by Brk, so give it a zeroed frame
+        if (MapDemandZeroPage(current_proc, addr_page) == ERROR) {
+            // Frames may free up once the disk catches up, so try again then
+            if (SwapWaitForIo(user_context)) {
+                return;
+            }
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "MapDemandZeroPage() failed.\n");
+            char *err_str = calloc(TERMINAL_MAX_LINE, sizeof(char));
+            sprintf(err_str, "Proc %d touched its heap, but out of free frames\n",
+                current_proc->pid);
+            KernelTtyWriteInternal(0, err_str, strnlen(err_str, TERMINAL_MAX_LINE), user_context);
+            free(err_str);
+            KernelExit(ERROR, user_context);
+        }
+    } else if (current_proc->region_1_page_table[addr_page].valid != 1) { // "address not mapped"
 
         bool below_current_stack = (addr_page < current_proc->lowest_user_stack_page);
         bool above_heap = (addr_page > current_proc->user_brk_page);
@@ -173,29 +278,23 @@ void TrapMemory(UserContext *user_context) {
 
             // Allocate every page from the right below the current lowest user stack
             // page down to the memory address hit
-            unsigned int page_to_alloc = current_proc->lowest_user_stack_page - 1;
-            while (page_to_alloc >= addr_page) {
-
-                // try to get a new frame, and handle error case
-                if (GetUnusedFrame(&(current_proc->region_1_page_table[page_to_alloc])) == ERROR) {
-                    TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "GetUnusedFrame() failed.\n");
-
-                    char *err_str = calloc(TERMINAL_MAX_LINE, sizeof(char));
-                    sprintf(err_str, "Proc %d tried to grow stack, but out of free frames\n",
-                        current_proc->pid);
-                    KernelTtyWriteInternal(0, err_str, strnlen(err_str, TERMINAL_MAX_LINE),
-                         user_context);
-                    free(err_str);
-
-                    KernelExit(ERROR, user_context);
+            if (MapNewRegion1Pages(current_proc, addr_page,
+                    current_proc->lowest_user_stack_page - addr_page,
+                    PROT_READ | PROT_WRITE) == ERROR) {
+                // Frames may free up once the disk catches up, so try again then
+                if (SwapWaitForIo(user_context)) {
+                    return;
                 }
-                assert(!current_proc->region_1_page_table[page_to_alloc].valid);
+                TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "MapNewRegion1Pages() failed.\n");
 
-                // set the pte data
-                current_proc->region_1_page_table[page_to_alloc].valid = 1;
-                current_proc->region_1_page_table[page_to_alloc].prot = PROT_READ | PROT_WRITE;
+                char *err_str = calloc(TERMINAL_MAX_LINE, sizeof(char));
+                sprintf(err_str, "Proc %d tried to grow stack, but out of free frames\n",
+                    current_proc->pid);
+                KernelTtyWriteInternal(0, err_str, strnlen(err_str, TERMINAL_MAX_LINE),
+                     user_context);
+                free(err_str);
 
-                --page_to_alloc;
+                KernelExit(ERROR, user_context);
             }
 
             // update pcb to reflect change
@@ -219,6 +318,21 @@ void TrapMemory(UserContext *user_context) {
             free(err_str);
             KernelExit(ERROR, user_context);
         }
+    } else if (current_proc->region_1_page_info[addr_page].copy_on_write) {
+        // Wrote to a page shared since fork, so it needs its own copy now
+        if (BreakCopyOnWrite(current_proc, addr_page) == ERROR) {
+            // Frames may free up once the disk catches up, so try again then
+            if (SwapWaitForIo(user_context)) {
+                return;
+            }
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "BreakCopyOnWrite() failed.\n");
+            char *err_str = calloc(TERMINAL_MAX_LINE, sizeof(char));
+            sprintf(err_str, "Proc %d wrote to a shared page, but out of free frames\n",
+                current_proc->pid);
+            KernelTtyWriteInternal(0, err_str, strnlen(err_str, TERMINAL_MAX_LINE), user_context);
+            free(err_str);
+            KernelExit(ERROR, user_context);
+        }
     } else { 
         // Page was mapped and in range, so must be invalid permissions
         TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, 
@@ -230,12 +344,17 @@ void TrapMemory(UserContext *user_context) {
         free(err_str);
         exit(-1);
     }
+
+    // Every path that didn't serve the fault has killed the proc or returned to retry it.
+    current_proc->stats.page_faults++;
+    ExitIfKilled(user_context);
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< TrapMemory()\n\n");
 }
 
 // Print message and kill
 void TrapMath(UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> TrapMath(%p)\n", user_context);
+    current_proc->stats.kernel_traps++;
     TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Killing proc on trap math \n");
     char *err_str = calloc(TERMINAL_MAX_LINE, sizeof(char));
     sprintf(err_str, "TRAP_MATH exception for proc %d\n", current_proc->pid);
@@ -272,7 +391,7 @@ void TrapTtyRecieve(UserContext *user_context) {
             assert(waiting_proc->tty_receive_buffer);
 
             // put proc back into ready queue
-            ListAppend(ready_queue, waiting_proc, waiting_proc->pid);
+            SchedulerMakeReady(waiting_proc);
 
             if (input_remaining <= waiting_proc->tty_receive_len) {
                 // Consuming all the input
@@ -332,8 +451,9 @@ void TrapTtyTransmit(UserContext *user_context) {
     // transmission complete
     // since done, take off transmitting list
     ListRemoveById(term.waiting_to_transmit, waiting_proc->pid);
-    ListAppend(ready_queue, waiting_proc, waiting_proc->pid);
+    SchedulerMakeReady(waiting_proc);
     free(waiting_proc->tty_transmit_buffer);
+    waiting_proc->tty_transmit_buffer = NULL;
 
     if (ListEmpty(term.waiting_to_transmit)) {
         return; // no other procs waiting on this term
@@ -353,6 +473,21 @@ void TrapTtyTransmit(UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< TrapTtyTransmit(%p)\n", user_context);
 }
 
+// Exits the current proc if it was killed while the pager or a terminal was busy with it.
+void ExitIfKilled(UserContext *user_context) {
+    if (current_proc->killed) {
+        TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Proc %d was killed.\n", current_proc->pid);
+        KernelExit(ERROR, user_context);
+    }
+}
+
+// A disk operation of the pager finished
+void TrapDisk(UserContext *user_context) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> TrapDisk(%p)\n", user_context);
+    SwapDiskInterrupt();
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< TrapDisk(%p)\n", user_context);
+}
+
 // Kill the proc
 void TrapNotDefined(UserContext *user_context) {
     TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "Unknown TRAP call. Killing proc\n");
@@ -378,6 +513,7 @@ void TrapTableInit() {
     table[TRAP_MATH] = (void*) &TrapMath;
     table[TRAP_TTY_RECEIVE] = (void*) &TrapTtyRecieve;
     table[TRAP_TTY_TRANSMIT] = (void*) &TrapTtyTransmit;
+    table[TRAP_DISK] = (void*) &TrapDisk;
 
     TracePrintf(TRACE_LEVEL_DETAIL_INFO, "Trap vector table address: %p\n", table);
     WriteRegister(REG_VECTOR_BASE, (unsigned int) table);
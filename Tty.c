@@ -16,8 +16,8 @@ void TtyInit(Tty *tty) {
     // Consumed consecutively, don't need hash
     tty->line_buffers = ListNewList(0);
 
-    // Consumed consecutively, don't need hash
-    tty->waiting_to_receive = ListNewList(0);
+    // Consumed consecutively, but will look up proc by id when it is killed
+    tty->waiting_to_receive = ListNewList(WAITING_TO_RECEIVE_HASH_SIZE);
 
     // Will look up proc by id when transmit recieves
     tty->waiting_to_transmit = ListNewList(WAITING_TO_TRANSMIT_HASH_SIZE);
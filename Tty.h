@@ -12,6 +12,7 @@ typedef struct Tty Tty;
 typedef struct LineBuffer LineBuffer;
 
 
+#define WAITING_TO_RECEIVE_HASH_SIZE 20
 #define WAITING_TO_TRANSMIT_HASH_SIZE 20
 
 /*
@@ -3,7 +3,10 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "LoadProgram.h"
 #include "Log.h"
+#include "PageOps.h"
+#include "Swap.h"
 
 /*
  * VMem.c
@@ -13,16 +16,157 @@
 extern PCB *current_proc;
 extern struct pte *region_0_page_table;
 
+// Whether each region 0 temp page is currently mapped by MapTempFrame().
+bool temp_page_in_use[NUM_TEMP_PAGES];
+
+// The region 1 page table REG_PTBR1 was last pointed at by UseRegion1ForProc(), or NULL if it
+// may have been pointed elsewhere or the table has been freed.
+struct pte *loaded_region_1_page_table;
+
 /*
-  Mallocs and initializes a region 1 page table with all invalid entries.
+  Mallocs and initializes a region 1 page table with all invalid entries, along with its
+  page info.
 */
 void CreateRegion1PageTable(PCB *pcb) {
     pcb->region_1_page_table = (struct pte *) calloc(NUM_PAGES_REG_1, sizeof(struct pte));
+    pcb->region_1_page_info = (PageInfo *) calloc(NUM_PAGES_REG_1, sizeof(PageInfo));
 
     unsigned int i;
     for (i = 0; i < NUM_PAGES_REG_1; i++) {
         pcb->region_1_page_table[i].valid = 0;
+        pcb->region_1_page_info[i].copy_on_write = false;
+        pcb->region_1_page_info[i].lazy = false;
+        pcb->region_1_page_info[i].clock_revoked = false;
+        pcb->region_1_page_info[i].swapped = false;
     }
+    pcb->program_image = NULL;
+}
+
+/*
+  Frees the region 1 page table and page info made by CreateRegion1PageTable(). Every page must
+  already be unmapped, e.g. by FreeRegion1PageTable().
+*/
+void DestroyRegion1PageTable(PCB *pcb) {
+    // The memory may be reused for another proc's table, whose entries the TLB doesn't have.
+    if (pcb->region_1_page_table == loaded_region_1_page_table) {
+        loaded_region_1_page_table = NULL;
+    }
+
+    free(pcb->region_1_page_table);
+    free(pcb->region_1_page_info);
+    pcb->region_1_page_table = NULL;
+    pcb->region_1_page_info = NULL;
+}
+
+/*
+  Points the MMU at the given proc's region 1 page table and flushes region 1 from the TLB,
+  unless that table is already the one in use, in which case the TLB entries are still good.
+*/
+void UseRegion1ForProc(PCB *pcb) {
+    if (pcb->region_1_page_table == loaded_region_1_page_table) {
+        return;
+    }
+
+    WriteRegister(REG_PTBR1, (unsigned int) pcb->region_1_page_table);
+    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+    loaded_region_1_page_table = pcb->region_1_page_table;
+}
+
+/*
+  Makes every valid page in the source region 1 page table valid in the dest region 1 page table,
+  mapped to the same frame. No data is copied. Pages that are writable are marked copy-on-write in
+  both tables and lose PROT_WRITE until one of them writes and gets its own frame in
+  BreakCopyOnWrite(). Lazy pages stay lazy in both, filled from the shared ProgramImage.
+  The source must be the current proc. Flushes region 1 from the TLB.
+*/
+void ShareRegion1PageTable(PCB *source, PCB *dest) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> ShareRegion1PageTable()\n");
+    assert(source == current_proc);
+
+    // Pages of the program that neither proc has touched yet are filled from the same image.
+    if (source->program_image) {
+        dest->program_image = source->program_image;
+        dest->program_image->ref_count++;
+    }
+
+    unsigned int i;
+    for (i = 0; i < NUM_PAGES_REG_1; i++) {
+        if (!source->region_1_page_table[i].valid) {
+            // Swapped out pages are read back from the same slot by whichever proc touches them.
+            dest->region_1_page_info[i] = source->region_1_page_info[i];
+            if (source->region_1_page_info[i].swapped) {
+                SwapRetainSlot(source->region_1_page_info[i].swap_slot);
+            }
+            continue;
+        }
+
+        // The protections to share are the real ones.
+        if (source->region_1_page_info[i].clock_revoked) {
+            SwapRestoreClockPage(source, i);
+        }
+
+        // Writable pages can't be written by either proc until they've been copied.
+        if (source->region_1_page_table[i].prot & PROT_WRITE) {
+            source->region_1_page_table[i].prot &= ~PROT_WRITE;
+            source->region_1_page_info[i].copy_on_write = true;
+        }
+
+        // Both procs now map the frame.
+        dest->region_1_page_table[i] = source->region_1_page_table[i];
+        dest->region_1_page_info[i] = source->region_1_page_info[i];
+        RetainUsedFrame(source->region_1_page_table[i].pfn);
+        AddFramesHeld(dest, 1);
+    }
+
+    // The source's writable pages may still be writable in the TLB.
+    WriteRegister(REG_TLB_FLUSH, TLB_FLUSH_1);
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< ShareRegion1PageTable()\n\n");
+}
+
+/*
+  Gives the given copy-on-write page of the current proc a frame of its own and restores
+  PROT_WRITE. If no other page table maps the frame anymore, the frame is simply kept.
+  Returns ERROR if there is not enough physical memory available to complete this call.
+*/
+int BreakCopyOnWrite(PCB *pcb, unsigned int page_num) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> BreakCopyOnWrite(%u)\n", page_num);
+    assert(pcb == current_proc);
+    assert(page_num < NUM_PAGES_REG_1);
+    assert(pcb->region_1_page_table[page_num].valid);
+    assert(pcb->region_1_page_info[page_num].copy_on_write);
+
+    struct pte *pte = &pcb->region_1_page_table[page_num];
+    void *page_addr = (void *) (VMEM_1_BASE + (page_num << PAGESHIFT));
+
+    // If we hold the only reference left, the frame is already ours.
+    if (GetFrameRefCount(pte->pfn) > 1) {
+        struct pte new_pte;
+        if (GetUnusedFrame(&new_pte) == ERROR) {
+            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "GetUnusedFrame() failed.\n");
+            return ERROR;
+        }
+
+        // Copy the shared page into the new frame through a temp page.
+        void *new_frame_addr = MapTempFrame(new_pte.pfn);
+        PageCopy(new_frame_addr, page_addr);
+        UnmapTempFrame(new_frame_addr);
+
+        // Point the page at the new frame, dropping our reference to the shared one.
+        ReleaseUsedFrame(pte->pfn);
+        pte->pfn = new_pte.pfn;
+        SetFrameOwner(pte->pfn, pcb, page_num);
+        pte->prot |= PROT_WRITE;
+        pcb->region_1_page_info[page_num].copy_on_write = false;
+        WriteRegister(REG_TLB_FLUSH, (unsigned int) page_addr);
+    } else {
+        pte->prot |= PROT_WRITE;
+        pcb->region_1_page_info[page_num].copy_on_write = false;
+        WriteRegister(REG_TLB_FLUSH, (unsigned int) page_addr);
+    }
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< BreakCopyOnWrite()\n\n");
+    return SUCCESS;
 }
 
 /*
@@ -35,52 +179,102 @@ int MapNewRegion1Pages(PCB *pcb, unsigned int start_page_num,
         unsigned int num_pages, unsigned int prot) {
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> MapNewRegion1Pages()\n");
 
-    unsigned int page_num;
-    for (page_num = start_page_num; page_num < start_page_num + num_pages; page_num++) {
-        assert(page_num < NUM_PAGES_REG_1);
-        assert(!(pcb->region_1_page_table[page_num].valid));
-
-        // get a new frame for each page
-        if (GetUnusedFrame(&pcb->region_1_page_table[page_num]) == ERROR) {
-            TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
-                    "Not enough unused physical frames to complete request.\n");
+    assert(start_page_num + num_pages <= NUM_PAGES_REG_1);
 
-            // Unmap pages that were mapped to rollback changes made thus far
-            UnmapRegion1Pages(pcb, start_page_num, page_num - start_page_num);
+    // Get a new frame for every page in one allocation, so there is nothing to roll back
+    // if there aren't enough.
+    unsigned int pfns[NUM_PAGES_REG_1];
+    if (GetUnusedFrames(num_pages, pfns) == ERROR) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM,
+                "Not enough unused physical frames to complete request.\n");
+        return ERROR;
+    }
 
-            return ERROR;
-        }
+    unsigned int i;
+    for (i = 0; i < num_pages; i++) {
+        unsigned int page_num = start_page_num + i;
+        assert(!(pcb->region_1_page_table[page_num].valid));
 
         // setup pte info
+        pcb->region_1_page_table[page_num].pfn = pfns[i];
         pcb->region_1_page_table[page_num].prot = prot;
         pcb->region_1_page_table[page_num].valid = 1;
+        SetFrameOwner(pfns[i], pcb, page_num);
     }
+    AddFramesHeld(pcb, num_pages);
 
     TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< MapNewRegion1Pages()\n\n");
     return SUCCESS;
 }
 
 /*
-  Starting at the given page number in region 1, unmaps num_pages pages to allocated
-  frames. All of the page table entries covered must be valid prior to this call, and all will be
-  invalid after the call.
+  Starting at the given page number in region 1, unmaps the num_pages pages and releases their
+  frames. Pages that are already invalid, e.g. heap pages that were reserved by Brk but never
+  touched, are skipped, though a swapped out page's swap slot is released. Flushes each unmapped
+  page from the TLB.
 */
-void UnmapRegion1Pages(PCB *pcb, unsigned int start_page_num,
+void UnmapTouchedRegion1Pages(PCB *pcb, unsigned int start_page_num,
         unsigned int num_pages) {
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> UnmapNewRegion1Pages()\n");
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> UnmapTouchedRegion1Pages()\n");
 
-    unsigned int page_num;
-    for (page_num = start_page_num; page_num < start_page_num + num_pages; page_num++) {
-        assert(page_num < NUM_PAGES_REG_1);
-        assert(pcb->region_1_page_table[page_num].valid);
+    assert(start_page_num + num_pages <= NUM_PAGES_REG_1);
 
-        unsigned int pfn = pcb->region_1_page_table[page_num].pfn;
-        ReleaseUsedFrame(pfn);
+    unsigned int pfns[NUM_PAGES_REG_1];
+    unsigned int num_pfns = 0;
+    unsigned int i;
+    for (i = 0; i < num_pages; i++) {
+        unsigned int page_num = start_page_num + i;
+        if (!pcb->region_1_page_table[page_num].valid) {
+            if (pcb->region_1_page_info[page_num].swapped) {
+                SwapReleaseSlot(pcb->region_1_page_info[page_num].swap_slot);
+                pcb->region_1_page_info[page_num].swapped = false;
+            }
+            continue;
+        }
+        pcb->region_1_page_info[page_num].clock_revoked = false;
 
+        pfns[num_pfns++] = pcb->region_1_page_table[page_num].pfn;
         pcb->region_1_page_table[page_num].valid = 0;
+        pcb->region_1_page_info[page_num].copy_on_write = false;
+        WriteRegister(REG_TLB_FLUSH, VMEM_1_BASE + (page_num << PAGESHIFT));
+    }
+
+    // Release all of the frames at once.
+    ReleaseUsedFrames(pfns, num_pfns);
+    AddFramesHeld(pcb, -(int) num_pfns);
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< UnmapTouchedRegion1Pages()\n\n");
+}
+
+/*
+  Maps the given invalid region 1 page to a newly allocated, zeroed frame, readable and writable.
+  Returns ERROR if there is not enough physical memory available to complete this call.
+*/
+int MapDemandZeroPage(PCB *pcb, unsigned int page_num) {
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, ">>> MapDemandZeroPage(%u)\n", page_num);
+    assert(page_num < NUM_PAGES_REG_1);
+
+    struct pte *pte = &pcb->region_1_page_table[page_num];
+    assert(!pte->valid);
+
+    if (GetUnusedFrame(pte) == ERROR) {
+        TracePrintf(TRACE_LEVEL_NON_TERMINAL_PROBLEM, "GetUnusedFrame() failed.\n");
+        return ERROR;
     }
 
-    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< UnmapNewRegion1Pages()\n\n");
+    // Zero the frame through a temp page before the user can see it.
+    void *frame_addr = MapTempFrame(pte->pfn);
+    PageZero(frame_addr);
+    UnmapTempFrame(frame_addr);
+
+    pte->prot = PROT_READ | PROT_WRITE;
+    pte->valid = 1;
+    pcb->region_1_page_info[page_num].copy_on_write = false;
+    SetFrameOwner(pte->pfn, pcb, page_num);
+    AddFramesHeld(pcb, 1);
+
+    TracePrintf(TRACE_LEVEL_FUNCTION_INFO, "<<< MapDemandZeroPage()\n\n");
+    return SUCCESS;
 }
 
 /*
@@ -150,19 +344,36 @@ void UnmapUsedRegion0Page(unsigned int page_number) {
 }
 
 /*
-  Frees all of the physical frames used by the valid region 1 page table entries,
-  and marks all region 1 page table entries as invalid.
+  Releases the physical frames used by the valid region 1 page table entries,
+  and marks all region 1 page table entries as invalid. Also releases the proc's ProgramImage.
 */
 void FreeRegion1PageTable(PCB *pcb) {
+    unsigned int pfns[NUM_PAGES_REG_1];
+    unsigned int num_pfns = 0;
+
     unsigned int i;
     for (i = 0; i < NUM_PAGES_REG_1; i++) {
+        pcb->region_1_page_info[i].lazy = false;
+        pcb->region_1_page_info[i].clock_revoked = false;
+        if (pcb->region_1_page_info[i].swapped) {
+            SwapReleaseSlot(pcb->region_1_page_info[i].swap_slot);
+            pcb->region_1_page_info[i].swapped = false;
+        }
         if (pcb->region_1_page_table[i].valid) {
             pcb->region_1_page_table[i].valid = 0;
+            pcb->region_1_page_info[i].copy_on_write = false;
 
-            unsigned int frame_number = pcb->region_1_page_table[i].pfn;
-            ReleaseUsedFrame(frame_number);
+            pfns[num_pfns] = pcb->region_1_page_table[i].pfn;
+            num_pfns++;
         }
     }
+
+    // Release all of the frames at once.
+    ReleaseUsedFrames(pfns, num_pfns);
+    AddFramesHeld(pcb, -(int) num_pfns);
+
+    // The program's untouched pages are gone, so its executable isn't needed anymore.
+    ReleaseProgramImage(pcb);
 }
 
 /*
@@ -170,13 +381,57 @@ void FreeRegion1PageTable(PCB *pcb) {
   and marks them as invalid.
 */
 void FreeRegion0StackPages(PCB *pcb) {
+    unsigned int pfns[NUM_KERNEL_PAGES];
+    unsigned int num_pfns = 0;
+
     int i;
     for (i = 0; i < NUM_KERNEL_PAGES; i++) {
         if (pcb->kernel_stack_page_table[i].valid) {
             pcb->kernel_stack_page_table[i].valid = 0;
 
-            unsigned int frame_number = pcb->kernel_stack_page_table[i].pfn;
-            ReleaseUsedFrame(frame_number);
+            pfns[num_pfns] = pcb->kernel_stack_page_table[i].pfn;
+            num_pfns++;
+        }
+    }
+
+    // Release all of the frames at once.
+    ReleaseUsedFrames(pfns, num_pfns);
+    AddFramesHeld(pcb, -(int) num_pfns);
+}
+
+/*
+  Maps the given frame into a free region 0 temp page, readable and writable by the kernel, and
+  returns the address of that page. Only that page is flushed from the TLB.
+*/
+void *MapTempFrame(unsigned int pfn) {
+    unsigned int i;
+    for (i = 0; i < NUM_TEMP_PAGES; i++) {
+        if (!temp_page_in_use[i]) {
+            break;
         }
     }
+    assert(i < NUM_TEMP_PAGES);
+    temp_page_in_use[i] = true;
+
+    unsigned int page_number = TEMP_PAGES_BASE_PAGE + i;
+    region_0_page_table[page_number].pfn = pfn;
+    region_0_page_table[page_number].prot = PROT_READ | PROT_WRITE;
+    region_0_page_table[page_number].valid = 1;
+    WriteRegister(REG_TLB_FLUSH, page_number << PAGESHIFT);
+
+    return (void *) (page_number << PAGESHIFT);
+}
+
+/*
+  Unmaps a temp page returned by MapTempFrame(). The frame itself is not released.
+*/
+void UnmapTempFrame(void *addr) {
+    unsigned int page_number = ((unsigned int) addr) >> PAGESHIFT;
+    assert(page_number >= TEMP_PAGES_BASE_PAGE);
+    assert(page_number < TEMP_PAGES_BASE_PAGE + NUM_TEMP_PAGES);
+    assert(temp_page_in_use[page_number - TEMP_PAGES_BASE_PAGE]);
+
+    region_0_page_table[page_number].valid = 0;
+    WriteRegister(REG_TLB_FLUSH, page_number << PAGESHIFT);
+    temp_page_in_use[page_number - TEMP_PAGES_BASE_PAGE] = false;
 }
@@ -9,15 +9,50 @@
 #define NUM_PAGES_REG_1 VMEM_1_SIZE / PAGESIZE
 #define REGION_1_BASE_PAGE ADDR_TO_PAGE(VMEM_1_BASE)
 
+// Region 0 pages just below the kernel stack that are kept out of the kernel heap, so that the
+// kernel can temporarily map any frame there with MapTempFrame().
+#define NUM_TEMP_PAGES 2
+#define TEMP_PAGES_BASE_PAGE ((KERNEL_STACK_BASE >> PAGESHIFT) - NUM_TEMP_PAGES)
+#define TEMP_PAGES_BASE (TEMP_PAGES_BASE_PAGE << PAGESHIFT)
+
 
 /*
-  Mallocs and initializes a region 1 page table with all invalid entries.
+  Mallocs and initializes a region 1 page table with all invalid entries, along with its
+  page info.
 */
 void CreateRegion1PageTable(PCB *pcb);
 
 /*
-  Frees all of the physical frames used by the valid region 1 page table entries,
-  and marks all region 1 page table entries as invalid.
+  Frees the region 1 page table and page info made by CreateRegion1PageTable(). Every page must
+  already be unmapped, e.g. by FreeRegion1PageTable().
+*/
+void DestroyRegion1PageTable(PCB *pcb);
+
+/*
+  Points the MMU at the given proc's region 1 page table and flushes region 1 from the TLB,
+  unless that table is already the one in use, in which case the TLB entries are still good.
+*/
+void UseRegion1ForProc(PCB *pcb);
+
+/*
+  Makes every valid page in the source region 1 page table valid in the dest region 1 page table,
+  mapped to the same frame. No data is copied. Pages that are writable are marked copy-on-write in
+  both tables and lose PROT_WRITE until one of them writes and gets its own frame in
+  BreakCopyOnWrite(). Lazy pages stay lazy in both, filled from the shared ProgramImage.
+  The source must be the current proc. Flushes region 1 from the TLB.
+*/
+void ShareRegion1PageTable(PCB *source, PCB *dest);
+
+/*
+  Gives the given copy-on-write page of the current proc a frame of its own and restores
+  PROT_WRITE. If no other page table maps the frame anymore, the frame is simply kept.
+  Returns ERROR if there is not enough physical memory available to complete this call.
+*/
+int BreakCopyOnWrite(PCB *pcb, unsigned int page_num);
+
+/*
+  Releases the physical frames used by the valid region 1 page table entries,
+  and marks all region 1 page table entries as invalid. Also releases the proc's ProgramImage.
 */
 void FreeRegion1PageTable(PCB *pcb);
 
@@ -37,13 +72,20 @@ int MapNewRegion1Pages(PCB *pcb, unsigned int start_page_num,
         unsigned int num_pages, unsigned int prot);
 
 /*
-  Starting at the given page number in region 1, unmaps num_pages pages to allocated
-  frames. All of the page table entries covered must be valid prior to this call, and all will be
-  invalid after the call.
+  Starting at the given page number in region 1, unmaps the num_pages pages and releases their
+  frames. Pages that are already invalid, e.g. heap pages that were reserved by Brk but never
+  touched, are skipped, though a swapped out page's swap slot is released. Flushes each unmapped
+  page from the TLB.
 */
-void UnmapRegion1Pages(PCB *pcb, unsigned int start_page_num,
+void UnmapTouchedRegion1Pages(PCB *pcb, unsigned int start_page_num,
         unsigned int num_pages);
 
+/*
+  Maps the given invalid region 1 page to a newly allocated, zeroed frame, readable and writable.
+  Returns ERROR if there is not enough physical memory available to complete this call.
+*/
+int MapDemandZeroPage(PCB *pcb, unsigned int page_num);
+
 /*
   Starting at the given page number in region 1, changes the protections on the next num_pages.
   All of the page table entries covered must be valid prior to this call.
@@ -61,3 +103,16 @@ int MapNewRegion0Page(unsigned int page_number);
   Unmaps a valid region 0 page, freeing the frame the page was mapped to.
 */
 void UnmapUsedRegion0Page(unsigned int page_number);
+
+/*
+  Maps the given frame into a free region 0 temp page, readable and writable by the kernel, and
+  returns the address of that page. Only that page is flushed from the TLB. There are
+  NUM_TEMP_PAGES temp pages, and every one must be unmapped before the kernel blocks or returns
+  to user mode.
+*/
+void *MapTempFrame(unsigned int pfn);
+
+/*
+  Unmaps a temp page returned by MapTempFrame(). The frame itself is not released.
+*/
+void UnmapTempFrame(void *addr);
@@ -21,6 +21,15 @@ int main(int argc, char *argv[]) {
     rc = Brk(buffer - 4096);
     TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "\t--> returned %d\n", rc);
 
+    // The heap pages are only mapped when touched, and should start out zeroed.
+    if (rc == SUCCESS) {
+        char *last_heap_byte = ((char *) (buffer - 4096)) - 1;
+        TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Touching the top of the heap: %d (should be 0)\n",
+            *last_heap_byte);
+        *last_heap_byte = 'x';
+        TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "\t--> wrote %c\n", *last_heap_byte);
+    }
+
     // Now Brk down a bit.
     TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Now Brki-ng down a bit.\n");
     rc = Brk(buffer - 4096 * 2);
@@ -0,0 +1,88 @@
+/**
+  Tests the fair scheduler. Run with sched=cfs, e.g. "yalnix sched=cfs theynix_tests/cfs_test",
+  and again with handoff=on as well.
+
+  Two hogs, one at the default priority and one 3 steps higher, spin side by side for RUN_TICKS
+  ticks; the higher one should get about twice the CPU. Then a sleeper that was delayed while a
+  hog ran wakes up and spins: it should run soon, but share the CPU with the hog instead of
+  running until it has caught up on the time it slept.
+*/
+
+#include <hardware.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+#define RUN_TICKS 40
+#define SLEEP_TICKS 40
+#define SLEEPER_ITERATIONS 5000000
+
+void Spin() {
+    while (1);
+}
+
+int UserTicks(int pid) {
+    ProcStats stats;
+    if (GetProcStats(pid, &stats) == ERROR) {
+        return ERROR;
+    }
+    return stats.user_ticks;
+}
+
+int main(int argc, char **argv) {
+    // Run at the top priority so that we get the CPU back to measure the hogs.
+    SetPriority(GetPid(), THEYNIX_PRIORITY_MAX);
+
+    int low_pid = Fork();
+    if (low_pid == 0) {
+        Spin();
+    }
+    SetPriority(low_pid, THEYNIX_PRIORITY_DEFAULT);
+
+    int high_pid = Fork();
+    if (high_pid == 0) {
+        Spin();
+    }
+    SetPriority(high_pid, THEYNIX_PRIORITY_DEFAULT + 3);
+
+    Delay(RUN_TICKS);
+    int low_ticks = UserTicks(low_pid);
+    int high_ticks = UserTicks(high_pid);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Hogs ran %d and %d ticks (the second should be about twice the first).\n",
+        low_ticks, high_ticks);
+    Kill(high_pid);
+    int status;
+    WaitPid(high_pid, &status, 0);
+
+    // The sleeper's virtual runtime falls far behind the hog's while it sleeps. It exits with the
+    // ticks it ran, and I measure the hog, since only a parent can see its children's stats.
+    int sleeper_pid = Fork();
+    if (sleeper_pid == 0) {
+        SetPriority(GetPid(), THEYNIX_PRIORITY_DEFAULT);
+        Delay(SLEEP_TICKS);
+
+        volatile int count = 0;
+        while (count < SLEEPER_ITERATIONS) {
+            count++;
+        }
+        Exit(UserTicks(GetPid()));
+    }
+
+    // Wake up right after the sleeper does.
+    Delay(SLEEP_TICKS);
+    int hog_ticks_before = UserTicks(low_pid);
+    int sleeper_ticks;
+    WaitPid(sleeper_pid, &sleeper_ticks, 0);
+    int hog_ticks_during = UserTicks(low_pid) - hog_ticks_before;
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "While the woken sleeper ran %d ticks, the hog ran %d (should be > 0, about as many).\n",
+        sleeper_ticks, hog_ticks_during);
+
+    Kill(low_pid);
+    WaitPid(low_pid, &status, 0);
+
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Done.\n");
+    return 0;
+}
@@ -0,0 +1,61 @@
+/**
+  Tests that Fork() shares memory copy-on-write. The parent fills a global, a heap buffer and a
+  stack buffer, then forks. The child overwrites all three and exits. The parent checks that it
+  still sees its own values, then has the kernel write into a shared page with Wait().
+*/
+
+#include <hardware.h>
+#include <stdlib.h>
+#include <yalnix.h>
+
+#include "Log.h"
+
+#define BUFFER_SIZE 4096
+
+int global_value = 17;
+
+// Still shared with the child when Wait() writes the status into it.
+int shared_status;
+
+int main(int argc, char **argv) {
+    char stack_buffer[BUFFER_SIZE];
+    char *heap_buffer = malloc(BUFFER_SIZE);
+    int i;
+    for (i = 0; i < BUFFER_SIZE; i++) {
+        stack_buffer[i] = 'p';
+        heap_buffer[i] = 'p';
+    }
+
+    int rc = Fork();
+    if (rc < 0) {
+        TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Fork failed.\n");
+        Exit(ERROR);
+    }
+
+    if (rc == 0) { // Child process
+        global_value = 42;
+        for (i = 0; i < BUFFER_SIZE; i++) {
+            stack_buffer[i] = 'c';
+            heap_buffer[i] = 'c';
+        }
+        TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Child: global %d, stack '%c', heap '%c'\n",
+            global_value, stack_buffer[BUFFER_SIZE - 1], heap_buffer[BUFFER_SIZE - 1]);
+        Exit(global_value);
+    }
+
+    // Parent process
+    rc = Wait(&shared_status);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Wait into a shared page: rc = %d, status = %d\n",
+        rc, shared_status);
+
+    for (i = 0; i < BUFFER_SIZE; i++) {
+        if (stack_buffer[i] != 'p' || heap_buffer[i] != 'p') {
+            TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Parent saw the child's write at %d!\n", i);
+            Exit(ERROR);
+        }
+    }
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Parent: global %d, stack '%c', heap '%c'\n",
+        global_value, stack_buffer[BUFFER_SIZE - 1], heap_buffer[BUFFER_SIZE - 1]);
+
+    return SUCCESS;
+}
@@ -0,0 +1,122 @@
+/**
+  Tests the Kill() syscall. Kills a child that is spinning, one that is delayed, one blocked on a
+  lock held by the parent, one waiting on a cvar, one reading an empty pipe, and one reading a
+  terminal, and collects ERROR for each. Also checks that killing a zombie, an unknown pid, init
+  or myself behaves.
+*/
+
+#include <hardware.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+void KillAndCollect(int pid, char *what) {
+    int rc = Kill(pid);
+    int status = -1;
+    int waited_pid = WaitPid(pid, &status, 0);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Kill() of the %s child: rc = %d, WaitPid() = %d, status = %d (should be 0, %d and %d).\n",
+        what, rc, waited_pid, status, pid, ERROR);
+}
+
+int main(int argc, char **argv) {
+    int pid = Fork();
+    if (pid == 0) { // Spins until killed
+        while (1);
+    }
+    Delay(2);
+    KillAndCollect(pid, "spinning");
+
+    pid = Fork();
+    if (pid == 0) {
+        Delay(1000);
+        Exit(1);
+    }
+    Delay(2);
+    KillAndCollect(pid, "delayed");
+
+    int lock_id;
+    LockInit(&lock_id);
+    Acquire(lock_id);
+    pid = Fork();
+    if (pid == 0) {
+        Acquire(lock_id);
+        Exit(1);
+    }
+    Delay(2);
+    KillAndCollect(pid, "lock blocked");
+    int rc = Release(lock_id);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Release() after its waiter was killed: rc = %d (should be 0).\n", rc);
+
+    int cvar_id;
+    CvarInit(&cvar_id);
+    pid = Fork();
+    if (pid == 0) {
+        Acquire(lock_id);
+        CvarWait(cvar_id, lock_id);
+        Exit(1);
+    }
+    Delay(2);
+    KillAndCollect(pid, "cvar waiting");
+    rc = Acquire(lock_id);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Acquire() after the cvar waiter was killed: rc = %d (should be 0).\n", rc);
+    Release(lock_id);
+
+    int pipe_id;
+    PipeInit(&pipe_id);
+    pid = Fork();
+    if (pid == 0) {
+        char buf[4];
+        PipeRead(pipe_id, buf, 4);
+        Exit(1);
+    }
+    Delay(2);
+    KillAndCollect(pid, "pipe reading");
+    PipeWrite(pipe_id, "abcd", 4);
+    char buf[4];
+    rc = PipeRead(pipe_id, buf, 4);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "PipeRead() after the reader was killed: rc = %d (should be 4).\n", rc);
+
+    pid = Fork();
+    if (pid == 0) {
+        char line[TERMINAL_MAX_LINE];
+        TtyRead(1, line, TERMINAL_MAX_LINE);
+        Exit(1);
+    }
+    Delay(2);
+    KillAndCollect(pid, "tty reading");
+
+    pid = Fork();
+    if (pid == 0) {
+        Exit(1);
+    }
+    Delay(2);
+    rc = Kill(pid);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Kill() of a zombie: rc = %d (should be %d).\n", rc, ERROR);
+    Wait(&rc);
+
+    rc = Kill(-5);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Kill() of a bad pid: rc = %d (should be %d).\n", rc, ERROR);
+
+    rc = Kill(1);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Kill() of init: rc = %d (should be %d).\n", rc, ERROR);
+
+    pid = Fork();
+    if (pid == 0) {
+        Kill(GetPid());
+        Exit(1);
+    }
+    int status = -1;
+    Wait(&status);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "A child that killed itself: status = %d (should be %d).\n", status, ERROR);
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/**
+  Tests the ListProcs() syscall and the process table. Forks a child that sleeps, one that
+  blocks reading a pipe and one that exits right away, then lists every proc and checks their
+  parents and states. Also checks that a short buffer gets only max procs and that a bad buffer
+  is an error.
+*/
+
+#include <hardware.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+#define MAX_LISTED 32
+
+ProcInfo procs[MAX_LISTED];
+
+char *state_names[] = { "running", "ready", "sleeping", "blocked", "zombie" };
+
+int main(int argc, char **argv) {
+    int pipe_id;
+    PipeInit(&pipe_id);
+
+    int sleeper_pid = Fork();
+    if (sleeper_pid == 0) { // Sleeping child
+        Delay(20);
+        Exit(0);
+    }
+
+    char c;
+    int reader_pid = Fork();
+    if (reader_pid == 0) { // Blocked child
+        PipeRead(pipe_id, &c, 1);
+        Exit(0);
+    }
+
+    int zombie_pid = Fork();
+    if (zombie_pid == 0) { // Zombie child
+        Exit(0);
+    }
+
+    // Let every child get to where it waits.
+    Delay(5);
+
+    int num_procs = ListProcs(procs, MAX_LISTED);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "ListProcs() found %d procs:\n", num_procs);
+    int i;
+    for (i = 0; i < num_procs; i++) {
+        TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+            "  pid %d, parent %d, %s, priority %d, %u frames, %u ticks\n", procs[i].pid,
+            procs[i].parent_pid, state_names[procs[i].state], procs[i].priority,
+            procs[i].frames_held, procs[i].user_ticks);
+    }
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "I am %d and running. Children %d, %d and %d should be sleeping, blocked and a zombie.\n",
+        GetPid(), sleeper_pid, reader_pid, zombie_pid);
+
+    int rc = ListProcs(procs, 1);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "ListProcs() with max 1: rc = %d (should be 1).\n", rc);
+
+    rc = ListProcs((ProcInfo *) 0, MAX_LISTED);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "ListProcs() into NULL: rc = %d (should be %d).\n",
+        rc, ERROR);
+
+    c = 'x';
+    PipeWrite(pipe_id, &c, 1);
+
+    int status;
+    while (Wait(&status) != ERROR);
+
+    // The freed pids go to the back of the queue, so a new child shouldn't reuse one of them.
+    int new_pid = Fork();
+    if (new_pid == 0) {
+        Exit(0);
+    }
+    Wait(&status);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "New child got pid %d, which should not be %d, %d or %d.\n",
+        new_pid, sleeper_pid, reader_pid, zombie_pid);
+
+    return 0;
+}
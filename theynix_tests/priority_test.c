@@ -0,0 +1,67 @@
+/*
+  Tests SetPriority and GetPriority, and that the scheduler gives a bigger share of the CPU to
+  procs of higher priority: forks a hog at the lowest priority and then one at the highest, each
+  spinning for the same number of iterations. The high priority hog should finish first.
+*/
+
+#include <hardware.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+#define HOG_ITERATIONS 20000000
+
+void Hog(char *name) {
+    volatile int count = 0;
+    while (count < HOG_ITERATIONS) {
+        count++;
+    }
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "The %s priority hog is done.\n", name);
+    Exit(0);
+}
+
+int main(int argc, char **argv) {
+    int my_pid = GetPid();
+
+    // Normal behavior
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "My priority is %d (should be %d)\n",
+        GetPriority(my_pid), THEYNIX_PRIORITY_DEFAULT);
+    int rc = SetPriority(my_pid, THEYNIX_PRIORITY_MAX);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "SetPriority on myself returned %d (should be 0)\n",
+        rc);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "My priority is %d (should be %d)\n",
+        GetPriority(my_pid), THEYNIX_PRIORITY_MAX);
+
+    // Out of range priorities
+    rc = SetPriority(my_pid, THEYNIX_PRIORITY_MAX + 1);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Too high priority returned %d (should be -1)\n", rc);
+    rc = SetPriority(my_pid, THEYNIX_PRIORITY_MIN - 1);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Too low priority returned %d (should be -1)\n", rc);
+
+    // Procs that are neither me nor my children
+    rc = SetPriority(0, THEYNIX_PRIORITY_MIN);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "SetPriority on idle returned %d (should be -1)\n", rc);
+    rc = GetPriority(-5);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "GetPriority on a bad pid returned %d (should be -1)\n",
+        rc);
+
+    // Children start with my priority, and I can change theirs.
+    int low_pid = Fork();
+    if (low_pid == 0) {
+        Hog("low");
+    }
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "My child's priority is %d (should be %d)\n",
+        GetPriority(low_pid), THEYNIX_PRIORITY_MAX);
+    SetPriority(low_pid, THEYNIX_PRIORITY_MIN);
+
+    if (Fork() == 0) {
+        Hog("high");
+    }
+
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "The high priority hog should be done first.\n");
+    int status;
+    while (Wait(&status) != ERROR);
+
+    return 0;
+}
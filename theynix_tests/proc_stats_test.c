@@ -0,0 +1,81 @@
+/**
+  Tests the GetProcStats() syscall. Checks that the caller's syscall, page fault, frame, tick and
+  context switch counts go up when it makes syscalls, touches new heap pages, spins and sleeps,
+  and that a live child's stats can be read but a bad pid or stats pointer can't.
+*/
+
+#include <hardware.h>
+#include <stdlib.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+#define NUM_GETPIDS 3
+#define NUM_HEAP_PAGES 8
+#define SPIN_ITERATIONS 5000000
+
+ProcStats before;
+ProcStats after;
+
+int main(int argc, char **argv) {
+    int pid = GetPid();
+    GetProcStats(pid, &before);
+
+    int i;
+    for (i = 0; i < NUM_GETPIDS; i++) {
+        GetPid();
+    }
+    GetProcStats(pid, &after);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "GetPid() calls counted: %d (should be %d).\n",
+        after.syscalls[THEYNIX_SYSCALL_TYPE(YALNIX_GETPID)]
+            - before.syscalls[THEYNIX_SYSCALL_TYPE(YALNIX_GETPID)], NUM_GETPIDS);
+
+    // Touch every page of a fresh heap buffer, so each one is faulted in.
+    GetProcStats(pid, &before);
+    char *buffer = (char *) malloc(NUM_HEAP_PAGES * PAGESIZE);
+    for (i = 0; i < NUM_HEAP_PAGES * PAGESIZE; i += PAGESIZE) {
+        buffer[i] = 'x';
+    }
+    GetProcStats(pid, &after);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Page faults: %u -> %u, frames held: %u -> %u, peak: %u (should all go up by about %d).\n",
+        before.page_faults, after.page_faults, before.frames_held, after.frames_held,
+        after.peak_frames_held, NUM_HEAP_PAGES);
+
+    // Spin, then sleep.
+    GetProcStats(pid, &before);
+    volatile int count = 0;
+    while (count < SPIN_ITERATIONS) {
+        count++;
+    }
+    Delay(2);
+    GetProcStats(pid, &after);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Ticks: %u -> %u (should go up), voluntary switches: %u -> %u (should go up by 1).\n",
+        before.user_ticks, after.user_ticks, before.voluntary_switches,
+        after.voluntary_switches);
+
+    int child_pid = Fork();
+    if (child_pid == 0) { // Child process
+        Delay(5);
+        Exit(0);
+    }
+
+    int rc = GetProcStats(child_pid, &after);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Child's stats: rc = %d, frames held = %u (should be 0 and more than 0).\n",
+        rc, after.frames_held);
+
+    rc = GetProcStats(pid + 1000, &after);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Stats of a stranger: rc = %d (should be %d).\n",
+        rc, ERROR);
+
+    rc = GetProcStats(pid, (ProcStats *) 0);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Stats into NULL: rc = %d (should be %d).\n",
+        rc, ERROR);
+
+    int status;
+    Wait(&status);
+    return 0;
+}
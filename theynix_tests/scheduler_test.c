@@ -0,0 +1,57 @@
+/**
+  Tests that the scheduler favors procs that block over CPU hogs. Forks NUM_HOGS children that
+  spin without blocking, then plays NUM_ROUNDS rounds of ping-pong over a pair of pipes with
+  another child. The hogs are demoted as they use up their quanta while the ping-pong procs
+  block on every round, so the ping-pong should finish well before the hogs do.
+*/
+
+#include <hardware.h>
+#include <yalnix.h>
+
+#include "Log.h"
+
+#define NUM_HOGS 4
+#define HOG_ITERATIONS 20000000
+#define NUM_ROUNDS 50
+
+int main(int argc, char **argv) {
+    int i;
+    for (i = 0; i < NUM_HOGS; i++) {
+        if (Fork() == 0) { // Hog process
+            volatile int count = 0;
+            while (count < HOG_ITERATIONS) {
+                count++;
+            }
+            TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Hog %d done.\n", i);
+            Exit(0);
+        }
+    }
+
+    int ping_pipe_id;
+    int pong_pipe_id;
+    PipeInit(&ping_pipe_id);
+    PipeInit(&pong_pipe_id);
+
+    char ball;
+    if (Fork() == 0) { // Pong process
+        for (i = 0; i < NUM_ROUNDS; i++) {
+            PipeRead(ping_pipe_id, &ball, 1);
+            PipeWrite(pong_pipe_id, &ball, 1);
+        }
+        Exit(0);
+    }
+
+    ball = 'x';
+    for (i = 0; i < NUM_ROUNDS; i++) {
+        PipeWrite(ping_pipe_id, &ball, 1);
+        PipeRead(pong_pipe_id, &ball, 1);
+    }
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Ping-pong done. This should be printed before any hog is done.\n");
+
+    int status;
+    while (Wait(&status) != ERROR);
+
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "All procs have exited.\n");
+    return 0;
+}
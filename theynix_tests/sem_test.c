@@ -0,0 +1,141 @@
+/**
+  Tests the SemInit(), SemUp() and SemDown() syscalls. Checks bad arguments, that a semaphore
+  counts, that waiters are woken in the order they blocked, that a unit handed to a waiter that
+  is killed before it runs goes to the next waiter, a bounded buffer of producers and consumers,
+  and Reclaim() of a semaphore.
+*/
+
+#include <hardware.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+#define NUM_ITEMS 20
+#define BUFFER_SIZE 4
+
+int main(int argc, char **argv) {
+    int rc = SemInit((int *) 10, 0);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "SemInit() w/ invalid pointer: rc = %d (should be %d).\n", rc, ERROR);
+
+    int sem_id;
+    rc = SemInit(&sem_id, -1);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "SemInit() w/ negative value: rc = %d (should be %d).\n", rc, ERROR);
+
+    rc = SemUp(2388);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "SemUp() w/ invalid id: rc = %d (should be %d).\n", rc, ERROR);
+
+    rc = SemDown(2388);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "SemDown() w/ invalid id: rc = %d (should be %d).\n", rc, ERROR);
+
+    // A semaphore made with 2 lets two downs through without blocking
+    SemInit(&sem_id, 2);
+    SemDown(sem_id);
+    rc = SemDown(sem_id);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Second SemDown() on a semaphore of 2: rc = %d (should be 0).\n", rc);
+
+    // Waiters block in order, and each up wakes the one that has waited longest
+    int order_pipe_id;
+    PipeInit(&order_pipe_id);
+    int i;
+    for (i = 0; i < 3; i++) {
+        if (Fork() == 0) {
+            Delay(i + 1);
+            SemDown(sem_id);
+            char c = '0' + i;
+            PipeWrite(order_pipe_id, &c, 1);
+            Exit(0);
+        }
+    }
+    Delay(5);
+
+    rc = Reclaim(sem_id);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Reclaim() w/ procs waiting: rc = %d (should be %d).\n", rc, ERROR);
+
+    char order[3];
+    for (i = 0; i < 3; i++) {
+        SemUp(sem_id);
+        PipeRead(order_pipe_id, &order[i], 1);
+    }
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Waiters woke in order %c%c%c (should be 012).\n", order[0], order[1], order[2]);
+    for (i = 0; i < 3; i++) {
+        Wait(&rc);
+    }
+
+    rc = Reclaim(sem_id);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Reclaim() of a semaphore: rc = %d (should be 0).\n",
+        rc);
+    rc = SemUp(sem_id);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "SemUp() after Reclaim(): rc = %d (should be %d).\n", rc, ERROR);
+
+    // A waiter killed after SemUp() woke it, but before it ran, passes its unit on. With
+    // handoff=on, the waiter runs right away instead, so this only applies without it.
+    int handed_sem_id;
+    SemInit(&handed_sem_id, 0);
+    int waiter_pids[2];
+    for (i = 0; i < 2; i++) {
+        waiter_pids[i] = Fork();
+        if (waiter_pids[i] == 0) {
+            Delay(i + 1);
+            SemDown(handed_sem_id);
+            char c = '0' + i;
+            PipeWrite(order_pipe_id, &c, 1);
+            Exit(0);
+        }
+    }
+    Delay(4);
+    SemUp(handed_sem_id);
+    rc = Kill(waiter_pids[0]);
+    char survivor;
+    PipeRead(order_pipe_id, &survivor, 1);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Kill() of the woken waiter: rc = %d, the unit went to waiter %c (should be 0 and 1).\n",
+        rc, survivor);
+    for (i = 0; i < 2; i++) {
+        Wait(&rc);
+    }
+
+    // A producer and a consumer share a bounded buffer, here a pipe, counting its empty and full
+    // slots with semaphores
+    int empty_id;
+    int full_id;
+    int buffer_pipe_id;
+    SemInit(&empty_id, BUFFER_SIZE);
+    SemInit(&full_id, 0);
+    PipeInit(&buffer_pipe_id);
+
+    if (Fork() == 0) { // Producer
+        for (i = 0; i < NUM_ITEMS; i++) {
+            SemDown(empty_id);
+            char c = 'a' + i;
+            PipeWrite(buffer_pipe_id, &c, 1);
+            SemUp(full_id);
+        }
+        Exit(0);
+    }
+
+    int num_in_order = 0;
+    for (i = 0; i < NUM_ITEMS; i++) {
+        SemDown(full_id);
+        char c;
+        PipeRead(buffer_pipe_id, &c, 1);
+        SemUp(empty_id);
+        if (c == 'a' + i) {
+            num_in_order++;
+        }
+    }
+    Wait(&rc);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Consumer got %d of %d items in order (should be %d).\n", num_in_order, NUM_ITEMS,
+        NUM_ITEMS);
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+  Tests that Spawn starts a program in a new child without running any more of the parent's
+  code in the child, that the parent can Wait for the child, and that Spawn handles bad input
+  like Exec.
+*/
+
+#include <hardware.h>
+#include <stdlib.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+int main(int argc, char **argv) {
+    // When spawned by ourselves, just report the argument and exit with it.
+    if (argc > 1) {
+        TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Spawned child %d got arg %s\n", GetPid(), argv[1]);
+        return atoi(argv[1]);
+    }
+
+    // Normal behavior
+    char *argvec[] = {"theynix_tests/spawn_test", "7", NULL};
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Spawning a child...\n");
+    int pid = Spawn("theynix_tests/spawn_test", argvec);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "\t--> returned %d\n", pid);
+
+    int status;
+    int rc = WaitPid(pid, &status, 0);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "WaitPid returned %d with status %d (should be %d, 7)\n", rc, status, pid);
+
+    // Bad filename
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Spawning with a bad filename...\n");
+    rc = Spawn("bogus_file_name.bogus_bogus_bogus", NULL);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "\t--> returned %d\n", rc);
+
+    // Illegal filename address
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Spawning with an illegal filename address...\n");
+    rc = Spawn((char *) 0, NULL);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "\t--> returned %d\n", rc);
+
+    // Illegal argvec address
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Spawning with an illegal argvec address...\n");
+    rc = Spawn("theynix_tests/spawn_test", (char **) 1);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "\t--> returned %d\n", rc);
+
+    // A failed spawn leaves no child behind.
+    rc = Wait(&status);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Wait with no children returned %d (should be %d)\n",
+        rc, ERROR);
+
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "If we got to here, all tests likely passed!\n");
+
+    return 0;
+}
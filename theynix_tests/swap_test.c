@@ -0,0 +1,84 @@
+/**
+  Tests that the kernel swaps pages out to the disk instead of running out of memory. Forks
+  NUM_CHILDREN children that each fill a big heap buffer with their own pattern, take turns
+  running with Delay(), and then check that their buffer still holds their pattern. Together the
+  buffers are bigger than physical memory, so some pages must be swapped out and back in. While
+  memory is full, each child also forks a grandchild that execs this program again, which must
+  wait for the pager instead of failing. Run with a small physical memory, e.g.
+  yalnix -s 1048576.
+*/
+
+#include <hardware.h>
+#include <stdlib.h>
+#include <yalnix.h>
+
+#include "Log.h"
+
+#define NUM_CHILDREN 6
+#define BUFFER_SIZE (384 * 1024)
+
+int main(int argc, char **argv) {
+    // Exec'd by a grandchild: getting this far is the test.
+    if (argc > 1) {
+        return 0;
+    }
+
+    int i;
+    for (i = 0; i < NUM_CHILDREN; i++) {
+        int rc = Fork();
+        if (rc < 0) {
+            TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Fork %d failed.\n", i);
+            break;
+        }
+
+        if (rc == 0) { // Child process
+            char pattern = 'a' + i;
+            char *buffer = malloc(BUFFER_SIZE);
+            if (!buffer) {
+                TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Child %d: malloc failed.\n", i);
+                Exit(ERROR);
+            }
+
+            int j;
+            for (j = 0; j < BUFFER_SIZE; j++) {
+                buffer[j] = pattern;
+            }
+
+            // Let the other children fill their buffers.
+            Delay(NUM_CHILDREN);
+
+            // Fork and exec while every frame is in use.
+            int grandchild_pid = Fork();
+            if (grandchild_pid == 0) {
+                char *exec_args[] = { argv[0], "exec", NULL };
+                Exec(argv[0], exec_args);
+                Exit(ERROR);
+            }
+            int grandchild_status = ERROR;
+            if (grandchild_pid > 0) {
+                Wait(&grandchild_status);
+            }
+            TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+                "Child %d: under pressure, forked %d, exec status %d (should be > 0 and 0)\n",
+                i, grandchild_pid, grandchild_status);
+
+            int bad_bytes = 0;
+            for (j = 0; j < BUFFER_SIZE; j++) {
+                if (buffer[j] != pattern) {
+                    bad_bytes++;
+                }
+            }
+            TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Child %d: %d bad bytes (should be 0)\n",
+                i, bad_bytes);
+            Exit(bad_bytes);
+        }
+    }
+
+    int status;
+    while (Wait(&status) != ERROR) {
+        TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "A child exited with status %d\n", status);
+    }
+
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "If every child exited with status 0, all tests passed!\n");
+    return 0;
+}
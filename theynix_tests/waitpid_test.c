@@ -0,0 +1,63 @@
+/**
+  Tests the WaitPid() syscall. Forks a slow child and a fast child, then waits for the slow one
+  first: the fast child's exit shouldn't wake the parent, and should stay collectable afterward.
+  Also checks THEYNIX_WNOHANG, waiting for a pid that isn't a child, bad flags, and that Wait()
+  still takes any child.
+*/
+
+#include <hardware.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+int main(int argc, char **argv) {
+    int slow_pid = Fork();
+    if (slow_pid == 0) { // Slow child
+        Delay(10);
+        Exit(1);
+    }
+
+    int fast_pid = Fork();
+    if (fast_pid == 0) { // Fast child
+        Exit(2);
+    }
+
+    int status = -1;
+    int rc = WaitPid(slow_pid, &status, THEYNIX_WNOHANG);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "WaitPid() with THEYNIX_WNOHANG before the slow child exits: rc = %d (should be 0).\n", rc);
+
+    rc = WaitPid(slow_pid, &status, 0);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "WaitPid() for the slow child: rc = %d, status = %d (should be %d and 1).\n",
+        rc, status, slow_pid);
+
+    rc = WaitPid(fast_pid, &status, THEYNIX_WNOHANG);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "WaitPid() for the fast child: rc = %d, status = %d (should be %d and 2).\n",
+        rc, status, fast_pid);
+
+    rc = WaitPid(fast_pid, &status, 0);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "WaitPid() for the collected fast child: rc = %d (should be %d).\n", rc, ERROR);
+
+    rc = WaitPid(GetPid(), &status, 0);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "WaitPid() for myself: rc = %d (should be %d).\n", rc, ERROR);
+
+    int any_pid = Fork();
+    if (any_pid == 0) {
+        Exit(3);
+    }
+
+    rc = WaitPid(any_pid, &status, 42);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "WaitPid() with bad flags: rc = %d (should be %d).\n", rc, ERROR);
+
+    rc = Wait(&status);
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Wait() for any child: rc = %d, status = %d (should be 0 and 3).\n", rc, status);
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+  Tests the Yield() syscall. First yields many times while no other proc is ready, which should
+  return right away each time rather than wait a clock tick like Delay(1). Then forks NUM_CHILDREN
+  children that each print and yield NUM_ROUNDS times, so their prints should interleave round
+  by round instead of each child printing every round in one quantum.
+*/
+
+#include <hardware.h>
+#include <yalnix.h>
+
+#include "Log.h"
+#include "TheynixCalls.h"
+
+#define NUM_LONE_YIELDS 1000
+#define NUM_CHILDREN 3
+#define NUM_ROUNDS 5
+
+int main(int argc, char **argv) {
+    int i;
+    for (i = 0; i < NUM_LONE_YIELDS; i++) {
+        if (Yield() != 0) {
+            TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Yield() failed!\n");
+            Exit(ERROR);
+        }
+    }
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "Yielded %d times with nothing else ready. This should take well under a tick each.\n",
+        NUM_LONE_YIELDS);
+
+    for (i = 0; i < NUM_CHILDREN; i++) {
+        if (Fork() == 0) { // Child process
+            int round;
+            for (round = 0; round < NUM_ROUNDS; round++) {
+                TracePrintf(TRACE_LEVEL_TESTING_OUTPUT, "Child %d: round %d.\n", i, round);
+                Yield();
+            }
+            Exit(0);
+        }
+    }
+
+    int status;
+    while (Wait(&status) != ERROR);
+
+    TracePrintf(TRACE_LEVEL_TESTING_OUTPUT,
+        "All children have exited. Their rounds should have been interleaved.\n");
+    return 0;
+}